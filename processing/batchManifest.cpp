@@ -0,0 +1,274 @@
+#include "batchManifest.h"
+#include "batchRunner.h"
+
+#include <iostream>
+#include <sstream>
+#include <functional>
+#include <algorithm>
+#include <type_traits>
+#include <cstdio>
+#include <cstdlib>
+using namespace std;
+
+static const char* kManifestHeader = "# corsikaReader manifest";
+
+/// --------------------------------------------------------------------------------------------
+/// Manifest
+/// --------------------------------------------------------------------------------------------
+bool BatchManifest::Open(const string& fileName, const string& outputName, string& error) {
+  fileName_ = fileName;
+  string text;
+  {
+    ifstream in(fileName, ios::binary);
+    if (in) {
+      ostringstream content;
+      content << in.rdbuf();
+      text = content.str();
+    }
+  }
+
+  // A line cut off by the end of a preempted job is not used
+  size_t end = text.rfind('\n');
+  istringstream lines(end == string::npos ? string() : text.substr(0, end + 1));
+  string line;
+  bool first = true;
+  while (getline(lines, line)) {
+    if (first) {
+      first = false;
+      if (line != string(kManifestHeader) + "\t" + outputName) {
+        error = fileName + " is not the manifest of the output " + outputName;
+        return false;
+      }
+      continue;
+    }
+    vector<string> fields;
+    istringstream split(line);
+    string field;
+    while (getline(split, field, '\t')) {
+      fields.push_back(field);
+    }
+    if (fields.size() < 5 || (fields[4] == "checkpoint" && fields.size() < 6)) {
+      continue;
+    }
+    ManifestEntry entry;
+    entry.status = fields[4];
+    entry.offset = strtoull(fields[3].c_str(), nullptr, 10);
+    entry.record = (fields.size() > 5) ? strtoull(fields[5].c_str(), nullptr, 10) : 0;
+    resumeOffset_ = entry.offset;
+
+    const string& input = fields[0];
+    uint64_t size;
+    int64_t mtime;
+    if (fileStamp(input, size, mtime) && to_string((unsigned long long) size) == fields[1] &&
+        to_string((long long) mtime) == fields[2]) {
+      entries_[input] = entry;
+    } else {
+      if (entry.status != "checkpoint") {
+        cerr << input << " has changed since it was processed, its rows in " << outputName
+             << " are those of the old file" << endl;
+      }
+      entries_.erase(input);
+    }
+  }
+  offset_ = resumeOffset_;
+
+  out_.open(fileName, ios::app);
+  if (!out_) {
+    error = "Cannot write the manifest " + fileName;
+    return false;
+  }
+  if (first) {
+    out_ << kManifestHeader << "\t" << outputName << "\n";
+  } else if (end + 1 != text.size()) {
+    out_ << "\n";
+  }
+  out_.flush();
+  return true;
+}
+
+const ManifestEntry* BatchManifest::Find(const string& input) const {
+  auto found = entries_.find(input);
+  return (found != entries_.end()) ? &found->second : nullptr;
+}
+
+bool BatchManifest::Append(const string& input, uint64_t offset, const string& status) {
+  uint64_t size = 0;
+  int64_t mtime = 0;
+  fileStamp(input, size, mtime);
+  out_ << input << "\t" << size << "\t" << mtime << "\t" << offset << "\t" << status << "\n";
+  out_.flush();
+  return (bool) out_;
+}
+
+void BatchManifest::Finish(const string& input, bool ok, uint64_t outputOffset) {
+  lock_guard<mutex> lock(mutex_);
+  offset_ = outputOffset;
+  if (!Append(input, offset_, ok ? "done" : "broken")) {
+    cerr << "Error writing the manifest " << fileName_ << endl;
+  }
+  remove(StateName(input).c_str());
+}
+
+void BatchManifest::Checkpoint(const string& input, size_t record) {
+  lock_guard<mutex> lock(mutex_);
+  if (!Append(input, offset_, "checkpoint\t" + to_string(record))) {
+    cerr << "Error writing the manifest " << fileName_ << endl;
+  }
+}
+
+string BatchManifest::StateName(const string& input) const {
+  ostringstream name;
+  name << fileName_ << "." << hex << hash<string>()(input) << ".state";
+  return name.str();
+}
+
+/// --------------------------------------------------------------------------------------------
+/// State files
+/// --------------------------------------------------------------------------------------------
+static_assert(is_trivially_copyable<EventHeader>::value, "EventHeader is saved as raw bytes");
+
+static const char kStateMagic[8] = {'C', 'O', 'R', 'S', 'C', 'K', 'P', '1'};
+
+template <class T>
+static void writeRaw(ostream& out, const T& value) {
+  out.write((const char*) &value, sizeof(T));
+}
+
+template <class T>
+static bool readRaw(istream& in, T& value) {
+  return (bool) in.read((char*) &value, sizeof(T));
+}
+
+static void writeDoubles(ostream& out, const vector<double>& values) {
+  writeRaw(out, (uint64_t) values.size());
+  out.write((const char*) values.data(), values.size() * sizeof(double));
+}
+
+/// Counts into counters, only if there are exactly as many as counters has
+static bool readCounters(istream& in, ShowerCounters& counters) {
+  vector<double> expected;
+  counters.Save(expected);
+  uint64_t n;
+  if (!readRaw(in, n) || n != expected.size()) {
+    return false;
+  }
+  vector<double> values(n);
+  if (!in.read((char*) values.data(), n * sizeof(double))) {
+    return false;
+  }
+  const double* next = values.data();
+  counters.Load(next);
+  return true;
+}
+
+bool saveParseState(const string& stateName, const string& input, int recordBytes, uint64_t resumeOffset,
+                    const ParseState& state, const ShowerCounters& counters) {
+  uint64_t size;
+  int64_t mtime;
+  if (!fileStamp(input, size, mtime)) {
+    return false;
+  }
+  string tempName = stateName + ".tmp";
+  {
+    ofstream out(tempName, ios::binary | ios::trunc);
+    out.write(kStateMagic, sizeof(kStateMagic));
+    writeRaw(out, (uint64_t) input.size());
+    out.write(input.data(), input.size());
+    writeRaw(out, size);
+    writeRaw(out, mtime);
+    writeRaw(out, (int32_t) recordBytes);
+    writeRaw(out, (uint64_t) sizeof(EventHeader));
+    writeRaw(out, (int32_t) state.perEvent);
+
+    writeRaw(out, resumeOffset);
+    writeRaw(out, (int32_t) state.lostBytes);
+    writeRaw(out, (uint64_t) state.record);
+    writeRaw(out, (int32_t) state.nrShow);
+    writeRaw(out, (int32_t) state.EVTEcnt);
+    writeRaw(out, state.event);
+    writeRaw(out, (uint64_t) state.headers.size());
+    for (const EventHeader& header : state.headers) {
+      writeRaw(out, header);
+    }
+    writeRaw(out, (uint64_t) state.events.size());
+    for (const EventCounters& event : state.events) {
+      vector<double> values;
+      event.counters.Save(values);
+      writeRaw(out, (uint64_t) event.header);
+      writeDoubles(out, values);
+    }
+    vector<double> values;
+    counters.Save(values);
+    writeDoubles(out, values);
+    if (!out.flush()) {
+      remove(tempName.c_str());
+      return false;
+    }
+  }
+  return rename(tempName.c_str(), stateName.c_str()) == 0;
+}
+
+bool loadParseState(const string& stateName, const string& input, int recordBytes, uint64_t& resumeOffset,
+                    ParseState& state, ShowerCounters& counters) {
+  ifstream in(stateName, ios::binary);
+  char magic[sizeof(kStateMagic)];
+  if (!in.read(magic, sizeof(magic)) || !equal(magic, magic + sizeof(magic), kStateMagic)) {
+    return false;
+  }
+  uint64_t nameLength;
+  if (!readRaw(in, nameLength) || nameLength != input.size()) {
+    return false;
+  }
+  string name(nameLength, '\0');
+  in.read(&name[0], nameLength);
+
+  uint64_t size, savedSize, headerBytes;
+  int64_t mtime, savedMtime;
+  int32_t savedRecordBytes, perEvent;
+  if (!in || name != input || !fileStamp(input, size, mtime) || !readRaw(in, savedSize) || !readRaw(in, savedMtime) ||
+      !readRaw(in, savedRecordBytes) || !readRaw(in, headerBytes) || !readRaw(in, perEvent) || savedSize != size ||
+      savedMtime != mtime || savedRecordBytes != recordBytes || headerBytes != sizeof(EventHeader) ||
+      (bool) perEvent != state.perEvent) {
+    return false;
+  }
+
+  ParseState saved;
+  saved.perEvent = state.perEvent;
+  uint64_t offset, record, nHeaders, nEvents;
+  int32_t lostBytes, nrShow, EVTEcnt;
+  if (!readRaw(in, offset) || !readRaw(in, lostBytes) || offset > size || !readRaw(in, record) || !readRaw(in, nrShow) || !readRaw(in, EVTEcnt) || !readRaw(in, saved.event) ||
+      !readRaw(in, nHeaders) || nHeaders * sizeof(EventHeader) > size) {
+    return false;
+  }
+  saved.record = record;
+  saved.lostBytes = lostBytes;
+  saved.nrShow = nrShow;
+  saved.EVTEcnt = EVTEcnt;
+  saved.headers.resize(nHeaders);
+  for (EventHeader& header : saved.headers) {
+    readRaw(in, header);
+  }
+  if (!readRaw(in, nEvents) || nEvents > nHeaders) {
+    return false;
+  }
+  saved.events.resize(nEvents);
+  for (EventCounters& event : saved.events) {
+    uint64_t header;
+    event.counters = counters.Empty();
+    if (!readRaw(in, header) || header >= nHeaders || !readCounters(in, event.counters)) {
+      return false;
+    }
+    event.header = header;
+  }
+  ShowerCounters restored = counters.Empty();
+  if (!readCounters(in, restored)) {
+    return false;
+  }
+
+  saved.exporter = state.exporter;
+  saved.index = state.index;
+  state = std::move(saved);
+  counters = restored;
+  resumeOffset = offset;
+  return true;
+}
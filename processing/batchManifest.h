@@ -0,0 +1,82 @@
+#ifndef BATCHMANIFEST_H
+#define BATCHMANIFEST_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+
+#include "showerParser.h"
+
+/// --------------------------------------------------------------------------------------------
+/// Completion manifest of a batch (--manifest), for restarting a preempted job
+/// --------------------------------------------------------------------------------------------
+/// Append-only text file next to the output (--output), after a "# corsikaReader manifest" line
+/// with the output name one tab separated line per step of the batch:
+///   <input> <size> <mtime in ns> <output offset> <status> [<record>]
+/// status is done or broken once the rows of the input are in the output, the output offset is
+/// then the end of its rows. While a file is parsed it is checkpoint with the number of records
+/// whose counts are saved in the state file <manifest>.<hash of the input>.state, the output
+/// offset is that of the last finished input.
+///
+/// A restarted batch truncates the output to the offset of the last line (rows of inputs that had
+/// not been finished yet are written again), skips the finished inputs (done or broken) and
+/// continues a checkpointed file from its state. Lines of an input whose size or modification time
+/// has changed since are ignored.
+struct ManifestEntry {
+  std::string status;          // done, broken or checkpoint
+  uint64_t offset = 0;         // output offset
+  size_t record = 0;           // checkpoint: records in the state file
+};
+
+class BatchManifest {
+ public:
+  /// Reads the manifest if it exists and opens it for appending. False with the reason in error if
+  /// it cannot be written or belongs to another output.
+  bool Open(const std::string& fileName, const std::string& outputName, std::string& error);
+
+  /// Last valid line of an input, nullptr if there is none
+  const ManifestEntry* Find(const std::string& input) const;
+
+  /// Output offset of the last line, where a restarted batch continues writing (0 for a new batch)
+  uint64_t ResumeOffset() const { return resumeOffset_; };
+
+  /// Appends the line of an input whose rows end at outputOffset and removes its state file
+  void Finish(const std::string& input, bool ok, uint64_t outputOffset);
+
+  /// Appends a checkpoint line once the state of input after record records is saved (any thread)
+  void Checkpoint(const std::string& input, size_t record);
+
+  /// State file of an input
+  std::string StateName(const std::string& input) const;
+
+ private:
+  bool Append(const std::string& input, uint64_t offset, const std::string& status);
+
+  std::string fileName_;
+  std::ofstream out_;
+  std::mutex mutex_;
+  std::map<std::string, ManifestEntry> entries_;
+  uint64_t resumeOffset_ = 0;
+  uint64_t offset_ = 0;        // end of the rows of the last finished input
+};
+
+/// --------------------------------------------------------------------------------------------
+/// Checkpoints of a file in progress
+/// --------------------------------------------------------------------------------------------
+/// The parse state (headers, shower counts, per-event counters) and the raw counts of the
+/// counters after state.record records, the next of which starts at byte resumeOffset (not a
+/// multiple of recordBytes after a --resync), written to a temporary file and renamed into place.
+/// The state file is binary in host layout and only meant for the same corsikaReader build.
+bool saveParseState(const std::string& stateName, const std::string& input, int recordBytes, uint64_t resumeOffset,
+                    const ParseState& state, const ShowerCounters& counters);
+
+/// Restores what saveParseState wrote for input. counters has to be set up as for a fresh parse
+/// (binning, spectra), false if there is no state file or it does not belong to the current input.
+bool loadParseState(const std::string& stateName, const std::string& input, int recordBytes, uint64_t& resumeOffset,
+                    ParseState& state, ShowerCounters& counters);
+
+#endif
@@ -0,0 +1,135 @@
+#include "batchRunner.h"
+
+#include <fstream>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <sys/stat.h>
+using namespace std;
+
+struct WorkQueue {
+  mutex m;
+  deque<size_t> items;
+};
+
+/// Own queue from the front (largest first), other queues from the back (their smallest items)
+static bool takeItem(vector<WorkQueue>& queues, size_t self, size_t& item) {
+  {
+    lock_guard<mutex> lock(queues[self].m);
+    if (!queues[self].items.empty()) {
+      item = queues[self].items.front();
+      queues[self].items.pop_front();
+      return true;
+    }
+  }
+  for (size_t k = 1; k < queues.size(); ++k) {
+    WorkQueue& victim = queues[(self + k) % queues.size()];
+    lock_guard<mutex> lock(victim.m);
+    if (!victim.items.empty()) {
+      item = victim.items.back();
+      victim.items.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+void runBatch(const vector<size_t>& cost, int nJobs,
+              const function<void(size_t)>& process, const function<bool(size_t)>& emit) {
+  const size_t nItems = cost.size();
+  if (nItems == 0) {
+    return;
+  }
+  if (nJobs < 1) {
+    nJobs = 1;
+  }
+  if ((size_t) nJobs > nItems) {
+    nJobs = nItems;
+  }
+
+  vector<size_t> order(nItems);
+  for (size_t i = 0; i < nItems; ++i) {
+    order[i] = i;
+  }
+  stable_sort(order.begin(), order.end(), [&cost](size_t a, size_t b) { return cost[a] > cost[b]; });
+
+  vector<WorkQueue> queues(nJobs);
+  for (size_t k = 0; k < nItems; ++k) {
+    queues[k % nJobs].items.push_back(order[k]);
+  }
+
+  vector<char> done(nItems, 0);
+  mutex doneMutex;
+  condition_variable doneCv;
+  atomic<bool> stop(false);
+
+  vector<thread> pool;
+  for (int w = 0; w < nJobs; ++w) {
+    pool.push_back(thread([&, w]() {
+      size_t item;
+      while (takeItem(queues, w, item)) {
+        if (!stop) {
+          process(item);
+        }
+        {
+          lock_guard<mutex> lock(doneMutex);
+          done[item] = 1;
+        }
+        doneCv.notify_all();
+      }
+    }));
+  }
+
+  for (size_t i = 0; i < nItems; ++i) {
+    {
+      unique_lock<mutex> lock(doneMutex);
+      doneCv.wait(lock, [&]() { return done[i] != 0; });
+    }
+    if (!emit(i)) {
+      stop = true;
+      break;
+    }
+  }
+
+  for (size_t w = 0; w < pool.size(); ++w) {
+    pool[w].join();
+  }
+}
+
+size_t fileSize(const string& fileName) {
+  struct stat st;
+  if (stat(fileName.c_str(), &st) != 0) {
+    return 0;
+  }
+  return st.st_size;
+}
+
+bool fileStamp(const string& fileName, uint64_t& size, int64_t& mtime) {
+  struct stat st;
+  if (stat(fileName.c_str(), &st) != 0) {
+    return false;
+  }
+  size = st.st_size;
+  mtime = (int64_t) st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+  return true;
+}
+
+bool readFileList(const string& listName, vector<string>& files) {
+  ifstream list(listName);
+  if (!list) {
+    return false;
+  }
+  string line;
+  while (getline(list, line)) {
+    size_t first = line.find_first_not_of(" \t\r");
+    if (first == string::npos || line[first] == '#') {
+      continue;
+    }
+    size_t last = line.find_last_not_of(" \t\r");
+    files.push_back(line.substr(first, last - first + 1));
+  }
+  return true;
+}
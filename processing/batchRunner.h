@@ -0,0 +1,30 @@
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+/// --------------------------------------------------------------------------------------------
+/// Work-stealing batch over many input files
+/// --------------------------------------------------------------------------------------------
+/// Runs process(i) for every item i in [0, cost.size()) on nJobs worker threads. Items are dealt
+/// out largest cost first over per-worker queues, a worker that runs dry steals from the back of
+/// the other queues. emit(i) is called on the calling thread, strictly in increasing i, as soon as
+/// items 0..i are all done. If emit returns false no further items are started or emitted.
+void runBatch(const std::vector<size_t>& cost, int nJobs,
+              const std::function<void(size_t)>& process, const std::function<bool(size_t)>& emit);
+
+/// Size of a file in bytes, 0 if it cannot be stat'ed
+size_t fileSize(const std::string& fileName);
+
+/// Size and modification time (in ns) of a file, false if it cannot be stat'ed. Outputs derived
+/// from a DAT file (its .index, a batch manifest) are only valid for exactly this stamp.
+bool fileStamp(const std::string& fileName, uint64_t& size, int64_t& mtime);
+
+/// Reads a list of file names, one per line (empty lines and lines starting with # are skipped)
+bool readFileList(const std::string& listName, std::vector<std::string>& files);
+
+#endif
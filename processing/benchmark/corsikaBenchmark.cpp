@@ -0,0 +1,167 @@
+// Throughput benchmark of the corsikaReader hot loop on synthetic CORSIKA files
+// Build and run with "make bench" in the processing directory
+//
+// Usage is ./corsikaBenchmark [--particles N] [--showers N] [--mu-fraction F] [--em-fraction F] [--repeat N]
+//                             [--curved] [--file DIR]
+//        ./corsikaBenchmark --write <OutputFile> [--particles N ...] --thinned|--standard
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <memory>
+#include <algorithm>
+using namespace std;
+
+#include "syntheticCorsika.h"
+#include "../showerParser.h"
+#include "../particleKernel.h"
+
+struct Measurement {
+  double seconds = 0.;
+  float nMuons = 0.;
+};
+
+/// Best of `repeat` passes of processRecord over the records of an in-memory file
+template <class Layout>
+static Measurement timeHotLoop(const vector<float>& file, int repeat) {
+  const size_t nFloats = Layout::recordBytes / sizeof(float);
+
+  Measurement best;
+  for (int r = 0; r < repeat; ++r) {
+    ParseState state;
+    ShowerCounters counters;
+    auto start = chrono::steady_clock::now();
+    for (size_t offset = 0; offset + nFloats <= file.size(); offset += nFloats) {
+      processRecord<Layout>(&file[offset], state, counters);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (r == 0 || seconds < best.seconds) {
+      best.seconds = seconds;
+      best.nMuons = counters.nMuons;
+    }
+  }
+  return best;
+}
+
+static Measurement timeHotLoop(const vector<float>& file, bool thinned, int repeat) {
+  return thinned ? timeHotLoop<ThinnedLayout>(file, repeat) : timeHotLoop<StandardLayout>(file, repeat);
+}
+
+/// Best of `repeat` passes through a record source (mmap or read-ahead reader), file in the page cache
+template <class Layout>
+static Measurement timeSource(const string& fileName, int repeat, const ReadSettings& io) {
+
+  Measurement best;
+  for (int r = 0; r < repeat; ++r) {
+    ParseState state;
+    ShowerCounters counters;
+    auto start = chrono::steady_clock::now();
+    std::unique_ptr<RecordSource> source = openRecordSource(fileName, Layout::recordBytes, io);
+    const float* sdata;
+    while ( (sdata = source->Next()) ) {
+      processRecord<Layout>(sdata, state, counters);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (r == 0 || seconds < best.seconds) {
+      best.seconds = seconds;
+      best.nMuons = counters.nMuons;
+    }
+  }
+  return best;
+}
+
+static Measurement timeSource(const string& fileName, bool thinned, int repeat, const ReadSettings& io) {
+  return thinned ? timeSource<ThinnedLayout>(fileName, repeat, io) : timeSource<StandardLayout>(fileName, repeat, io);
+}
+
+static void report(const string& name, const Measurement& m, long records, long particles, double bytes) {
+  cout << left << setw(28) << name << right
+       << setw(12) << setprecision(4) << records / m.seconds / 1.e3 << " krec/s"
+       << setw(12) << setprecision(4) << particles / m.seconds / 1.e6 << " Mpart/s"
+       << setw(10) << setprecision(3) << bytes / m.seconds / 1.e9 << " GB/s"
+       << "   (nMu " << setprecision(7) << m.nMuons << ")" << endl;
+}
+
+int main (int argc, char *argv[]) {
+  SyntheticConfig config;
+  int repeat = 5;
+  string writeFile;
+  string fileDir = "/tmp";
+  bool thinnedGiven = false;
+  bool standardGiven = false;
+
+  for (int k = 1; k < argc; ++k) {
+    string arg = argv[k];
+    if (arg == "--particles" && k + 1 < argc) {
+      config.particlesPerShower = atol(argv[++k]);
+    } else if (arg == "--showers" && k + 1 < argc) {
+      config.nShowers = atoi(argv[++k]);
+    } else if (arg == "--mu-fraction" && k + 1 < argc) {
+      config.muonFraction = atof(argv[++k]);
+    } else if (arg == "--em-fraction" && k + 1 < argc) {
+      config.emFraction = atof(argv[++k]);
+    } else if (arg == "--repeat" && k + 1 < argc) {
+      repeat = max(1, atoi(argv[++k]));
+    } else if (arg == "--curved") {
+      config.curved = true;
+    } else if (arg == "--file" && k + 1 < argc) {
+      fileDir = argv[++k];
+    } else if (arg == "--write" && k + 1 < argc) {
+      writeFile = argv[++k];
+    } else if (arg == "--thinned") {
+      thinnedGiven = true;
+    } else if (arg == "--standard") {
+      standardGiven = true;
+    } else {
+      cerr << "Unknown option " << arg << ", see the top of corsikaBenchmark.cpp for the usage" << endl;
+      return 1;
+    }
+  }
+
+  if (!writeFile.empty()) {
+    config.thinned = !standardGiven;
+    if (!writeCorsikaFile(writeFile, generateCorsikaFile(config))) {
+      cerr << "Cannot write " << writeFile << endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  const char* kernels[] = {"scalar", "avx2", "avx512"};
+
+  for (int layout = 0; layout < 2; ++layout) {
+    config.thinned = (layout == 0);
+    if ((config.thinned && standardGiven && !thinnedGiven) || (!config.thinned && thinnedGiven && !standardGiven)) {
+      continue;
+    }
+    vector<float> file = generateCorsikaFile(config);
+    const long records = syntheticRecords(file, config.thinned);
+    const long particles = config.particlesPerShower * config.nShowers;
+    const double bytes = file.size() * sizeof(float);
+
+    cout << (config.thinned ? "thinned" : "standard") << ": " << records << " records, " << particles
+         << " particles, " << setprecision(3) << bytes / 1.e6 << " MB" << endl;
+
+    for (int k = 0; k < 3; ++k) {
+      if (!selectParticleKernel(kernels[k])) {
+        continue;
+      }
+      report(string("  hot loop, ") + kernels[k], timeHotLoop(file, config.thinned, repeat), records, particles, bytes);
+    }
+    selectParticleKernel("auto");
+
+    string fileName = fileDir + "/corsikaBenchmark_" + (config.thinned ? "thinned" : "standard") + ".dat";
+    if (writeCorsikaFile(fileName, file)) {
+      ReadSettings io;
+      report(string("  mmap file, ") + particleKernelName(), timeSource(fileName, config.thinned, repeat, io), records, particles, bytes);
+      io.async = true;
+      report(string("  async-io file, ") + particleKernelName(), timeSource(fileName, config.thinned, repeat, io), records, particles, bytes);
+      remove(fileName.c_str());
+    }
+  }
+  return 0;
+}
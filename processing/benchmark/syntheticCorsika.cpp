@@ -0,0 +1,127 @@
+#include "syntheticCorsika.h"
+
+#include <fstream>
+#include <random>
+#include <cstring>
+#include <math.h>
+using namespace std;
+
+static float tagWord(const char* tag) {
+  float word;
+  memcpy(&word, tag, sizeof(float));
+  return word;
+}
+
+static float markerWord(bool thinned) {
+  int marker = thinned ? 26208 : 22932;   // record length in bytes, read back as 3.67252e-41 / 3.21346e-41
+  float word;
+  memcpy(&word, &marker, sizeof(float));
+  return word;
+}
+
+/// Appends sub-blocks to the file, opening a new record every 21 sub-blocks
+class RecordWriter {
+  vector<float>& file;
+  bool thinned;
+  int nsblstd;
+  int blocksInRecord = 0;
+public:
+  RecordWriter(vector<float>& out, bool thin)
+    : file(out), thinned(thin), nsblstd(thin ? 312 : 273) {};
+
+  float* NextSubBlock() {
+    if (blocksInRecord == 0) {
+      file.push_back(markerWord(thinned));
+    }
+    size_t start = file.size();
+    file.resize(start + nsblstd, 0.f);
+    if (++blocksInRecord == 21) {
+      file.push_back(markerWord(thinned));
+      blocksInRecord = 0;
+    }
+    return &file[start];
+  };
+
+  void Finish() {
+    while (blocksInRecord != 0) {
+      NextSubBlock();
+    }
+  };
+};
+
+vector<float> generateCorsikaFile(const SyntheticConfig& config) {
+  vector<float> file;
+  RecordWriter writer(file, config.thinned);
+  mt19937 rng(config.seed);
+  uniform_real_distribution<double> uniform(0., 1.);
+  exponential_distribution<double> lateral(1. / (config.lateralScale * 100.));
+
+  const int stride = config.thinned ? 8 : 7;
+  const int nParticles = 39;
+
+  float* runh = writer.NextSubBlock();
+  runh[0] = tagWord("RUNH");
+  runh[92] = config.nShowers;
+
+  for (int shower = 0; shower < config.nShowers; ++shower) {
+    float* evth = writer.NextSubBlock();
+    evth[0] = tagWord("EVTH");
+    evth[1] = shower + 1;
+    evth[2] = 14;                          // proton
+    evth[3] = 1.e8;                        // GeV
+    evth[10] = config.zenith;
+    evth[11] = config.azimuth;
+    evth[46] = 1;
+    evth[47] = config.obslev;
+    evth[167] = config.curved ? 1 : 0;
+
+    long left = config.particlesPerShower;
+    while (left > 0) {
+      float* block = writer.NextSubBlock();
+      for (int p = 0; p < nParticles && left > 0; ++p, --left) {
+        float* part = block + p * stride;
+        double kind = uniform(rng);
+        int id;
+        if (kind < config.muonFraction) {
+          id = uniform(rng) < 0.5 ? 5 : 6;
+        } else if (kind < config.muonFraction + config.emFraction) {
+          id = uniform(rng) < 0.5 ? 2 : 3;
+        } else {
+          id = uniform(rng) < 0.7 ? 1 : 13;
+        }
+        double energy = exp(log(0.1) + uniform(rng) * (log(1.e4) - log(0.1)));  // GeV
+        double r = lateral(rng);
+        double phi = 2. * M_PI * uniform(rng);
+
+        part[0] = id * 1000 + (int) (uniform(rng) * 30) * 10 + 1;  // id, hadronic generation, obs. level
+        part[1] = energy * 0.05 * (uniform(rng) - 0.5);
+        part[2] = energy * 0.05 * (uniform(rng) - 0.5);
+        part[3] = energy;
+        part[4] = r * cos(phi);
+        part[5] = r * sin(phi);
+        part[6] = 1.e4 * uniform(rng);
+        if (config.thinned) {
+          part[7] = uniform(rng) < config.thinnedFraction ? 1. + 99. * uniform(rng) : 1.;
+        }
+      }
+    }
+
+    float* evte = writer.NextSubBlock();
+    evte[0] = tagWord("EVTE");
+  }
+
+  float* rune = writer.NextSubBlock();
+  rune[0] = tagWord("RUNE");
+  writer.Finish();
+  return file;
+}
+
+long syntheticRecords(const vector<float>& file, bool thinned) {
+  return file.size() * sizeof(float) / (thinned ? 26216 : 22940);
+}
+
+bool writeCorsikaFile(const string& fileName, const vector<float>& file) {
+  ofstream out(fileName, ofstream::binary);
+  out.write((const char*) file.data(), file.size() * sizeof(float));
+  return (bool) out;
+}
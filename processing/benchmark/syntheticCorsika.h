@@ -0,0 +1,36 @@
+#ifndef SYNTHETICCORSIKA_H
+#define SYNTHETICCORSIKA_H
+
+#include <string>
+#include <vector>
+
+/// --------------------------------------------------------------------------------------------
+/// Synthetic CORSIKA DAT files for benchmarks and PGO training
+/// --------------------------------------------------------------------------------------------
+/// Produces a complete file: RUNH, then per shower EVTH, the particle sub-blocks and EVTE, then RUNE,
+/// packed 21 sub-blocks per record between the record length markers of the thinned/standard format.
+/// Particle positions follow an exponential lateral profile, muon energies a log-uniform spectrum.
+struct SyntheticConfig {
+  bool thinned = true;
+  int nShowers = 1;
+  long particlesPerShower = 200000;
+  double muonFraction = 0.2;    // id 5, 6
+  double emFraction = 0.6;      // id 2, 3, the rest are photons and hadrons
+  double thinnedFraction = 0.3; // share of particles with a thinning weight > 1 (thinned files only)
+  double zenith = 0.6;          // rad
+  double azimuth = 1.2;         // rad
+  bool curved = false;
+  double obslev = 140000.;      // cm
+  double lateralScale = 300.;   // m, mean core distance
+  unsigned seed = 1;
+};
+
+/// The whole file as floats, record length markers included
+std::vector<float> generateCorsikaFile(const SyntheticConfig& config);
+
+/// Number of records in a generated file
+long syntheticRecords(const std::vector<float>& file, bool thinned);
+
+bool writeCorsikaFile(const std::string& fileName, const std::vector<float>& file);
+
+#endif
@@ -0,0 +1,183 @@
+#include "columnFile.h"
+
+#include <cstring>
+
+using namespace std;
+
+static const char kMagic[8] = {'C', 'O', 'R', 'S', 'C', 'O', 'L', '1'};
+
+/// x86 and ARM Linux are little-endian, the file format is defined that way
+template <typename T>
+static void writeValue(ofstream& out, T value) {
+  out.write((const char*) &value, sizeof(T));
+}
+
+static void writeString(ofstream& out, const string& text) {
+  writeValue<uint32_t>(out, text.size());
+  out.write(text.data(), text.size());
+}
+
+template <typename T>
+static bool readValue(ifstream& in, T& value) {
+  return (bool) in.read((char*) &value, sizeof(T));
+}
+
+static bool readString(ifstream& in, string& text) {
+  uint32_t length;
+  if (!readValue(in, length)) {
+    return false;
+  }
+  text.resize(length);
+  return length == 0 || in.read(&text[0], length);
+}
+
+template <typename T>
+static bool readValues(ifstream& in, size_t n, vector<double>& values) {
+  vector<T> data(n);
+  if ( !in.read((char*) data.data(), n * sizeof(T)) ) {
+    return false;
+  }
+  values.insert(values.end(), data.begin(), data.end());
+  return true;
+}
+
+ColumnWriter::ColumnWriter(const string& fileName, const vector<ColumnSpec>& columns_,
+                           const vector<pair<string, string> >& metadata, size_t rowsPerGroup_)
+  : out(fileName, ofstream::binary), columns(columns_), pending(columns_.size()), rowsPerGroup(rowsPerGroup_) {
+  out.write(kMagic, sizeof(kMagic));
+  writeValue<uint32_t>(out, metadata.size());
+  for (size_t k = 0; k < metadata.size(); ++k) {
+    writeString(out, metadata[k].first);
+    writeString(out, metadata[k].second);
+  }
+  writeValue<uint32_t>(out, columns.size());
+  for (size_t c = 0; c < columns.size(); ++c) {
+    writeString(out, columns[c].name);
+    writeValue<uint8_t>(out, (uint8_t) columns[c].type);
+  }
+}
+
+ColumnWriter::~ColumnWriter() {
+  Close();
+}
+
+void ColumnWriter::AddRow(const vector<double>& values) {
+  for (size_t c = 0; c < columns.size(); ++c) {
+    pending[c].push_back(c < values.size() ? values[c] : 0.);
+  }
+  nPending += 1;
+  if (nPending >= rowsPerGroup) {
+    WriteGroup();
+  }
+}
+
+void ColumnWriter::WriteGroup() {
+  if (nPending == 0) {
+    return;
+  }
+  writeValue<uint32_t>(out, nPending);
+  for (size_t c = 0; c < columns.size(); ++c) {
+    const vector<double>& values = pending[c];
+    switch (columns[c].type) {
+      case ColumnType::Int32: {
+        vector<int32_t> data(values.begin(), values.end());
+        out.write((const char*) data.data(), data.size() * sizeof(int32_t));
+        break;
+      }
+      case ColumnType::Float32: {
+        vector<float> data(values.begin(), values.end());
+        out.write((const char*) data.data(), data.size() * sizeof(float));
+        break;
+      }
+      case ColumnType::Float64:
+        out.write((const char*) values.data(), values.size() * sizeof(double));
+        break;
+    }
+    pending[c].clear();
+  }
+  nRows += nPending;
+  nPending = 0;
+}
+
+bool ColumnWriter::Close() {
+  if (!closed) {
+    closed = true;
+    WriteGroup();
+    writeValue<uint32_t>(out, 0);
+    writeValue<uint64_t>(out, nRows);
+    out.close();
+  }
+  return !out.fail();
+}
+
+bool readColumnFile(const string& fileName, vector<ColumnSpec>& columns, vector<pair<string, string> >& metadata,
+                    vector<vector<double> >& values, string& error) {
+  columns.clear();
+  metadata.clear();
+  values.clear();
+  ifstream in(fileName, ifstream::binary);
+  char magic[sizeof(kMagic)];
+  if (!in) {
+    error = "cannot open " + fileName;
+    return false;
+  }
+  if ( !in.read(magic, sizeof(magic)) || memcmp(magic, kMagic, sizeof(kMagic)) != 0 ) {
+    error = fileName + " is not a column file";
+    return false;
+  }
+  error = fileName + " is cut short";
+
+  uint32_t n;
+  if (!readValue(in, n)) {
+    return false;
+  }
+  metadata.resize(n);
+  for (uint32_t k = 0; k < n; ++k) {
+    if ( !readString(in, metadata[k].first) || !readString(in, metadata[k].second) ) {
+      return false;
+    }
+  }
+  if (!readValue(in, n)) {
+    return false;
+  }
+  columns.resize(n);
+  for (uint32_t c = 0; c < n; ++c) {
+    uint8_t type;
+    if ( !readString(in, columns[c].name) || !readValue(in, type) ) {
+      return false;
+    }
+    if (type < (uint8_t) ColumnType::Int32 || type > (uint8_t) ColumnType::Float64) {
+      error = fileName + ": unknown type of column " + columns[c].name;
+      return false;
+    }
+    columns[c].type = (ColumnType) type;
+  }
+
+  values.resize(columns.size());
+  uint64_t total = 0;
+  uint32_t rows;
+  while (readValue(in, rows) && rows > 0) {
+    for (size_t c = 0; c < columns.size(); ++c) {
+      bool ok = false;
+      switch (columns[c].type) {
+        case ColumnType::Int32: ok = readValues<int32_t>(in, rows, values[c]); break;
+        case ColumnType::Float32: ok = readValues<float>(in, rows, values[c]); break;
+        case ColumnType::Float64: ok = readValues<double>(in, rows, values[c]); break;
+      }
+      if (!ok) {
+        return false;
+      }
+    }
+    total += rows;
+  }
+  uint64_t expected;
+  if ( !in || !readValue(in, expected) ) {
+    return false;
+  }
+  if (expected != total) {
+    error = fileName + ": the row count at the end does not match the row groups";
+    return false;
+  }
+  error.clear();
+  return true;
+}
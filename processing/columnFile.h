@@ -0,0 +1,65 @@
+#ifndef COLUMNFILE_H
+#define COLUMNFILE_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+
+/// --------------------------------------------------------------------------------------------
+/// Binary column file of the output rows (--columns)
+/// --------------------------------------------------------------------------------------------
+/// Typed, named columns plus key/value metadata, so the rows of many showers can be loaded without
+/// parsing text (corsikaColumns.py reads them into numpy arrays). Layout, all numbers little-endian:
+///
+///   magic       8 bytes "CORSCOL1"
+///   metadata    uint32 n, then n times key, value (strings)
+///   columns     uint32 n, then n times name (string), type (uint8: 1 int32, 2 float32, 3 float64)
+///   row groups  uint32 rows > 0, then every column in header order as rows fixed-width values
+///   end         uint32 0, uint64 total number of rows
+///
+/// A string is a uint32 length followed by that many bytes. Rows are written in groups so the
+/// writer keeps only one group in memory, a file without the end marker was cut short.
+enum class ColumnType : uint8_t {Int32 = 1, Float32 = 2, Float64 = 3};
+
+struct ColumnSpec {
+  std::string name;
+  ColumnType type;
+};
+
+class ColumnWriter {
+public:
+  ColumnWriter(const std::string& fileName, const std::vector<ColumnSpec>& columns,
+               const std::vector<std::pair<std::string, std::string> >& metadata, size_t rowsPerGroup = 65536);
+  ~ColumnWriter();
+
+  /// One value per column, converted to the type of its column
+  void AddRow(const std::vector<double>& values);
+
+  /// Writes the last group and the end marker, false if anything could not be written
+  bool Close();
+
+  bool Good() const { return out.good(); };
+  size_t NumColumns() const { return columns.size(); };
+
+private:
+  void WriteGroup();
+
+  std::ofstream out;
+  std::vector<ColumnSpec> columns;
+  std::vector<std::vector<double> > pending;   // values of the current group, one vector per column
+  size_t rowsPerGroup;
+  size_t nPending = 0;
+  uint64_t nRows = 0;
+  bool closed = false;
+};
+
+/// Reads a whole column file, values[c][r] is row r of column c. False with the reason in error
+/// if the file cannot be read, is not a column file or was cut short.
+bool readColumnFile(const std::string& fileName, std::vector<ColumnSpec>& columns,
+                    std::vector<std::pair<std::string, std::string> >& metadata,
+                    std::vector<std::vector<double> >& values, std::string& error);
+
+#endif
@@ -0,0 +1,415 @@
+#include "compressedStream.h"
+
+#include <fstream>
+#include <memory>
+#include <cstring>
+#include <algorithm>
+#include <zlib.h>
+#ifdef CORSIKA_BZIP2
+#include <bzlib.h>
+#endif
+#ifdef CORSIKA_ZSTD
+#include <zstd.h>
+#endif
+using namespace std;
+
+static const size_t kRingBlocks = 8;          // blocks the worker may run ahead of the parser
+static const size_t kInputBytes = 1 << 20;    // compressed bytes per read
+static const size_t kRecordsPerBlock = 40;    // about 1 MB of thinned records per ring block
+
+Compression detectCompression(const string& fileName) {
+  unsigned char magic[4] = {0, 0, 0, 0};
+  ifstream in(fileName, ifstream::binary);
+  in.read((char*) magic, 4);
+  size_t n = in.gcount();
+  if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+    return Compression::Gzip;
+  }
+  if (n >= 3 && magic[0] == 'B' && magic[1] == 'Z' && magic[2] == 'h') {
+    return Compression::Bzip2;
+  }
+  if (n >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+    return Compression::Zstd;
+  }
+  return Compression::None;
+}
+
+const char* compressionName(Compression type) {
+  switch (type) {
+    case Compression::Gzip: return "gzip";
+    case Compression::Bzip2: return "bzip2";
+    case Compression::Zstd: return "zstd";
+    default: return "none";
+  }
+}
+
+/// --------------------------------------------------------------------------------------------
+/// Decoders, one Step() decodes as much of in as fits into out
+/// --------------------------------------------------------------------------------------------
+enum class StepResult {More, End, Error};
+
+struct Decoder {
+  virtual ~Decoder() {};
+  virtual StepResult Step(const char*& in, size_t& inLeft, char*& out, size_t& outLeft) = 0;
+  /// True between two streams, the data may end here
+  virtual bool AtBoundary() const = 0;
+  string error;
+};
+
+struct CopyDecoder : public Decoder {
+  StepResult Step(const char*& in, size_t& inLeft, char*& out, size_t& outLeft) {
+    size_t take = min(inLeft, outLeft);
+    memcpy(out, in, take);
+    in += take;
+    inLeft -= take;
+    out += take;
+    outLeft -= take;
+    return StepResult::More;
+  }
+  bool AtBoundary() const { return true; };
+};
+
+struct GzipDecoder : public Decoder {
+  z_stream zs;
+  bool ok = false;
+  bool inMember = true;
+
+  GzipDecoder() {
+    memset(&zs, 0, sizeof(zs));
+    ok = (inflateInit2(&zs, 15 + 16) == Z_OK);   // gzip header and trailer
+  }
+  ~GzipDecoder() {
+    if (ok) {
+      inflateEnd(&zs);
+    }
+  }
+
+  StepResult Step(const char*& in, size_t& inLeft, char*& out, size_t& outLeft) {
+    if (!ok) {
+      error = "cannot initialize zlib";
+      return StepResult::Error;
+    }
+    if (!inMember) {
+      // Another gzip member follows, anything else (tar padding, zeros) ends the data
+      if ((unsigned char) in[0] != 0x1f) {
+        return StepResult::End;
+      }
+      inflateReset(&zs);
+      inMember = true;
+    }
+    zs.next_in = (Bytef*) in;
+    zs.avail_in = inLeft;
+    zs.next_out = (Bytef*) out;
+    zs.avail_out = outLeft;
+    int ret = inflate(&zs, Z_NO_FLUSH);
+    in += inLeft - zs.avail_in;
+    inLeft = zs.avail_in;
+    out += outLeft - zs.avail_out;
+    outLeft = zs.avail_out;
+    if (ret == Z_STREAM_END) {
+      inMember = false;
+    } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+      error = zs.msg ? zs.msg : "corrupt gzip data";
+      return StepResult::Error;
+    }
+    return StepResult::More;
+  }
+  bool AtBoundary() const { return !inMember; };
+};
+
+#ifdef CORSIKA_BZIP2
+struct Bzip2Decoder : public Decoder {
+  bz_stream bs;
+  bool ok = false;
+  bool inStream = true;
+
+  Bzip2Decoder() {
+    memset(&bs, 0, sizeof(bs));
+    ok = (BZ2_bzDecompressInit(&bs, 0, 0) == BZ_OK);
+  }
+  ~Bzip2Decoder() {
+    if (ok) {
+      BZ2_bzDecompressEnd(&bs);
+    }
+  }
+
+  StepResult Step(const char*& in, size_t& inLeft, char*& out, size_t& outLeft) {
+    if (!inStream) {
+      if (in[0] != 'B') {
+        return StepResult::End;
+      }
+      BZ2_bzDecompressEnd(&bs);
+      memset(&bs, 0, sizeof(bs));
+      ok = (BZ2_bzDecompressInit(&bs, 0, 0) == BZ_OK);
+      inStream = true;
+    }
+    if (!ok) {
+      error = "cannot initialize bzip2";
+      return StepResult::Error;
+    }
+    bs.next_in = (char*) in;
+    bs.avail_in = inLeft;
+    bs.next_out = out;
+    bs.avail_out = outLeft;
+    int ret = BZ2_bzDecompress(&bs);
+    in += inLeft - bs.avail_in;
+    inLeft = bs.avail_in;
+    out += outLeft - bs.avail_out;
+    outLeft = bs.avail_out;
+    if (ret == BZ_STREAM_END) {
+      inStream = false;
+    } else if (ret != BZ_OK) {
+      error = "corrupt bzip2 data";
+      return StepResult::Error;
+    }
+    return StepResult::More;
+  }
+  bool AtBoundary() const { return !inStream; };
+};
+#endif
+
+#ifdef CORSIKA_ZSTD
+struct ZstdDecoder : public Decoder {
+  ZSTD_DStream* ds;
+  size_t hint = 1;   // 0 at the end of a frame
+
+  ZstdDecoder() : ds(ZSTD_createDStream()) {
+    if (ds) {
+      ZSTD_initDStream(ds);
+    }
+  }
+  ~ZstdDecoder() {
+    ZSTD_freeDStream(ds);
+  }
+
+  StepResult Step(const char*& in, size_t& inLeft, char*& out, size_t& outLeft) {
+    if (!ds) {
+      error = "cannot initialize zstd";
+      return StepResult::Error;
+    }
+    ZSTD_inBuffer input = {in, inLeft, 0};
+    ZSTD_outBuffer output = {out, outLeft, 0};
+    hint = ZSTD_decompressStream(ds, &output, &input);
+    in += input.pos;
+    inLeft -= input.pos;
+    out += output.pos;
+    outLeft -= output.pos;
+    if (ZSTD_isError(hint)) {
+      error = ZSTD_getErrorName(hint);
+      return StepResult::Error;
+    }
+    return StepResult::More;
+  }
+  bool AtBoundary() const { return hint == 0; };
+};
+#endif
+
+static Decoder* makeDecoder(Compression type) {
+  switch (type) {
+    case Compression::None: return new CopyDecoder();
+    case Compression::Gzip: return new GzipDecoder();
+#ifdef CORSIKA_BZIP2
+    case Compression::Bzip2: return new Bzip2Decoder();
+#endif
+#ifdef CORSIKA_ZSTD
+    case Compression::Zstd: return new ZstdDecoder();
+#endif
+    default: return nullptr;
+  }
+}
+
+/// --------------------------------------------------------------------------------------------
+/// Ring of decompressed blocks
+/// --------------------------------------------------------------------------------------------
+CompressedStream::CompressedStream(const string& fileName_, size_t blockBytes_)
+  : fileName(fileName_), blockBytes(blockBytes_), ring(kRingBlocks), ringBytes(kRingBlocks, 0) {
+  worker = thread(&CompressedStream::Decompress, this);
+}
+
+CompressedStream::~CompressedStream() {
+  {
+    lock_guard<mutex> lock(m);
+    stopped = true;
+  }
+  spaceReady.notify_all();
+  worker.join();
+}
+
+/// Waits for a free slot of the ring, a null pointer if the consumer is gone
+char* CompressedStream::ProducerBlock() {
+  unique_lock<mutex> lock(m);
+  spaceReady.wait(lock, [this] { return stopped || produced - released < kRingBlocks; });
+  if (stopped) {
+    return nullptr;
+  }
+  vector<char>& block = ring[produced % kRingBlocks];
+  lock.unlock();
+  block.resize(blockBytes);   // only allocates on the first round through the ring
+  return block.data();
+}
+
+bool CompressedStream::Commit(size_t bytes) {
+  {
+    lock_guard<mutex> lock(m);
+    if (stopped) {
+      return false;
+    }
+    ringBytes[produced % kRingBlocks] = bytes;
+    produced += 1;
+  }
+  dataReady.notify_one();
+  return true;
+}
+
+void CompressedStream::Decompress() {
+  string status;
+  ifstream in(fileName, ifstream::binary);
+  Compression type = detectCompression(fileName);
+  unique_ptr<Decoder> decoder(makeDecoder(type));
+
+  if (!in) {
+    status = "cannot open " + fileName;
+  } else if (!decoder) {
+    status = string(compressionName(type)) + " support is not compiled in, cannot read " + fileName;
+  } else {
+    vector<char> input(kInputBytes);
+    const char* next = input.data();
+    size_t inLeft = 0;
+    char* block = ProducerBlock();
+    char* out = block;
+    size_t outLeft = blockBytes;
+
+    while (block) {
+      if (inLeft == 0) {
+        in.read(input.data(), input.size());
+        next = input.data();
+        inLeft = in.gcount();
+        if (inLeft == 0) {
+          if ( !decoder->AtBoundary() ) {
+            status = "unexpected end of the compressed data in " + fileName;
+          }
+          break;
+        }
+      }
+      StepResult result = decoder->Step(next, inLeft, out, outLeft);
+      if (result == StepResult::Error) {
+        status = "corrupt " + string(compressionName(type)) + " data in " + fileName + ": " + decoder->error;
+        break;
+      }
+      if (outLeft == 0) {
+        if ( !Commit(blockBytes) ) {
+          return;
+        }
+        block = out = ProducerBlock();
+        outLeft = blockBytes;
+      }
+      if (result == StepResult::End) {
+        break;
+      }
+    }
+    if (!block || (outLeft < blockBytes && !Commit(blockBytes - outLeft))) {
+      return;
+    }
+  }
+
+  {
+    lock_guard<mutex> lock(m);
+    finished = true;
+    error = status;
+  }
+  dataReady.notify_all();
+}
+
+/// Releases the block being read and waits for the next one, false at the end of the data
+bool CompressedStream::Acquire() {
+  unique_lock<mutex> lock(m);
+  if (holding) {
+    released += 1;
+    holding = false;
+    spaceReady.notify_one();
+  }
+  dataReady.wait(lock, [this] { return finished || consumed < produced; });
+  if (consumed == produced) {
+    return false;
+  }
+  current = ring[consumed % kRingBlocks].data();
+  currentBytes = ringBytes[consumed % kRingBlocks];
+  currentPos = 0;
+  consumed += 1;
+  holding = true;
+  return true;
+}
+
+size_t CompressedStream::Read(char* dst, size_t n) {
+  size_t done = 0;
+  while (done < n) {
+    if (currentPos == currentBytes && !Acquire()) {
+      break;
+    }
+    size_t take = min(n - done, currentBytes - currentPos);
+    memcpy(dst + done, current + currentPos, take);
+    currentPos += take;
+    done += take;
+  }
+  return done;
+}
+
+const char* CompressedStream::ReadContiguous(size_t n, char* scratch, size_t* got) {
+  if (currentPos == currentBytes && !Acquire()) {
+    return nullptr;
+  }
+  if (currentBytes - currentPos >= n) {
+    const char* data = current + currentPos;
+    currentPos += n;
+    return data;
+  }
+  size_t read = Read(scratch, n);
+  if (got) {
+    *got = read;
+  }
+  return (read == n) ? scratch : nullptr;
+}
+
+bool CompressedStream::Failed() const {
+  lock_guard<mutex> lock(m);
+  return !error.empty();
+}
+
+string CompressedStream::Error() const {
+  lock_guard<mutex> lock(m);
+  return error;
+}
+
+CompressedRecordSource::CompressedRecordSource(const string& fileName, size_t recBytes)
+  : stream(fileName, kRecordsPerBlock * recBytes), scratch(recBytes / sizeof(float)) {
+}
+
+const float* CompressedRecordSource::Next() {
+  return (const float*) stream.ReadContiguous(scratch.size() * sizeof(float), (char*) scratch.data(), &partial);
+}
+
+bool readCompressedFile(const string& fileName, string& text) {
+  ifstream probe(fileName);
+  if (!probe) {
+    return false;
+  }
+  CompressedStream stream(fileName);
+  text.clear();
+  char buffer[1 << 16];
+  size_t n;
+  while ( (n = stream.Read(buffer, sizeof(buffer))) > 0 ) {
+    text.append(buffer, n);
+  }
+  return !stream.Failed();
+}
+
+string stripCompressionSuffix(const string& fileName) {
+  const char* suffixes[] = {".gz", ".bz2", ".zst"};
+  for (const char* suffix : suffixes) {
+    size_t n = strlen(suffix);
+    if (fileName.size() > n && fileName.compare(fileName.size() - n, n, suffix) == 0) {
+      return fileName.substr(0, fileName.size() - n);
+    }
+  }
+  return fileName;
+}
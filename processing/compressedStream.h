@@ -0,0 +1,90 @@
+#ifndef COMPRESSEDSTREAM_H
+#define COMPRESSEDSTREAM_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+#include "recordSource.h"
+
+/// --------------------------------------------------------------------------------------------
+/// Decompression on a background thread
+/// --------------------------------------------------------------------------------------------
+/// The format is recognized by its magic bytes, not by the file name. gzip is always available,
+/// bzip2 and zstd if the build found their libraries (CORSIKA_BZIP2, CORSIKA_ZSTD). Concatenated
+/// streams (pigz, pbzip2, zstd -T) are read as one.
+enum class Compression {None, Gzip, Bzip2, Zstd};
+
+Compression detectCompression(const std::string& fileName);
+const char* compressionName(Compression type);
+
+/// A worker thread reads and decompresses the file into a ring of blocks while the calling
+/// thread parses the previous ones, so decompression and parsing overlap. Read() blocks until
+/// data is available and returns less than requested only at the end of the data or after an
+/// error, Failed() tells the two apart. Uncompressed files are passed through.
+class CompressedStream {
+public:
+  explicit CompressedStream(const std::string& fileName, size_t blockBytes = 1 << 20);
+  ~CompressedStream();
+
+  size_t Read(char* dst, size_t n);
+
+  /// The next n bytes, pointing into the ring if they lie in one block (always the case for
+  /// records when blockBytes is a multiple of the record length), otherwise copied to scratch.
+  /// A null pointer if fewer than n bytes are left, those are in scratch then (*got of them).
+  /// Valid until the next call.
+  const char* ReadContiguous(size_t n, char* scratch, size_t* got = nullptr);
+
+  bool Failed() const;
+  std::string Error() const;
+
+private:
+  void Decompress();
+  char* ProducerBlock();
+  bool Commit(size_t bytes);
+  bool Acquire();
+
+  std::string fileName;
+  size_t blockBytes;
+  std::vector<std::vector<char> > ring;
+  std::vector<size_t> ringBytes;
+  size_t produced = 0;     // blocks handed to the consumer
+  size_t consumed = 0;     // blocks taken by the consumer
+  size_t released = 0;     // blocks the consumer is done with, their slots can be refilled
+  bool finished = false;
+  bool stopped = false;
+  std::string error;
+  mutable std::mutex m;
+  std::condition_variable dataReady;
+  std::condition_variable spaceReady;
+
+  const char* current = nullptr;   // block being consumed
+  size_t currentBytes = 0;
+  size_t currentPos = 0;
+  bool holding = false;
+  std::thread worker;
+};
+
+/// Whole records out of a compressed DAT file, handed out straight from the decompression ring
+class CompressedRecordSource : public RecordSource {
+  CompressedStream stream;
+  std::vector<float> scratch;
+  size_t partial = 0;
+public:
+  CompressedRecordSource(const std::string& fileName, size_t recBytes);
+
+  const float* Next();
+  std::string Error() const { return stream.Error(); };
+  size_t Trailing(const char*& data) { data = (const char*) scratch.data(); return partial; };
+};
+
+/// Reads a whole (possibly compressed) file into text
+bool readCompressedFile(const std::string& fileName, std::string& text);
+
+/// DAT000001.gz -> DAT000001, names without a .gz/.bz2/.zst ending are returned unchanged
+std::string stripCompressionSuffix(const std::string& fileName);
+
+#endif
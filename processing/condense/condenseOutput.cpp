@@ -0,0 +1,478 @@
+// Condenses the per-file corsikaReader outputs into one file per model/energy block/primary/atmosphere,
+// the native replacement of the loops in cleanup/CondenseOutput.sh
+// Build with "make condense" in the processing directory
+//
+// Usage is ./condenseOutput <DataDir> <OutputDir> --header <HeaderFile> [--format text|columns] [--jobs N]
+//                           [--expected N] [--overwrite]
+//
+// <DataDir>/<model>/<energyblock>/<primary>/DATaannnn[.txt|.ccol] is the output of one DAT file (text row or
+// column file), aa is the atmosphere. Every group goes to <OutputDir>/<model>/<energyblock>/<primary>-<energyblock>-atm<aa>.txt
+// (.ccol with --format columns), rows in shower ID order. The data directory is scanned once and the groups
+// are merged in parallel.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+#include <dirent.h>
+#include <sys/stat.h>
+using namespace std;
+
+#include "../batchRunner.h"
+#include "../columnFile.h"
+
+/// Output of one DAT file, DAT010003.txt has shower ID 10003 and belongs to atmosphere 01
+struct InputFile {
+  string path;
+  string name;
+  long showerID;
+  bool columns;
+};
+
+struct Group {
+  string model;
+  string energy;
+  string primary;
+  string atmosphere;
+  vector<InputFile> files;
+  size_t bytes = 0;
+};
+
+struct GroupResult {
+  string output;
+  size_t rows = 0;
+  bool skipped = false;
+  vector<string> problems;
+};
+
+struct CondenseOptions {
+  vector<string> header;        // column names
+  string headerLine;
+  bool columns = false;
+  bool overwrite = false;
+  long expected = 0;            // showers per atmosphere, IDs aa0000 ... aa0000 + expected - 1
+};
+
+/// Names of the entries of a directory, sorted, without . and ..
+static vector<string> listDirectory(const string& dir) {
+  vector<string> names;
+  DIR* d = opendir(dir.c_str());
+  if (!d) {
+    return names;
+  }
+  while (struct dirent* entry = readdir(d)) {
+    string name = entry->d_name;
+    if (name != "." && name != "..") {
+      names.push_back(name);
+    }
+  }
+  closedir(d);
+  sort(names.begin(), names.end());
+  return names;
+}
+
+static bool isDirectory(const string& path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+/// DATaannnn, DATaannnn.txt or DATaannnn.ccol, false for anything else (logs, .long files ...)
+static bool parseInputName(const string& name, InputFile& file, string& atmosphere) {
+  if (name.compare(0, 3, "DAT") != 0) {
+    return false;
+  }
+  size_t end = 3;
+  while (end < name.size() && isdigit((unsigned char) name[end])) {
+    end += 1;
+  }
+  string digits = name.substr(3, end - 3);
+  string extension = name.substr(end);
+  if (digits.size() < 3 || (extension != "" && extension != ".txt" && extension != ".ccol")) {
+    return false;
+  }
+  file.name = name;
+  file.showerID = atol(digits.c_str());
+  file.columns = (extension == ".ccol");
+  atmosphere = digits.substr(0, 2);
+  return true;
+}
+
+/// One pass over <dataDir>/<model>/<energyblock>/<primary>/, groups sorted by name, files by shower ID
+static vector<Group> scanDataDirectory(const string& dataDir) {
+  map<string, Group> groups;
+  for (const string& model : listDirectory(dataDir)) {
+    string modelDir = dataDir + "/" + model;
+    if (!isDirectory(modelDir)) {
+      continue;
+    }
+    for (const string& energy : listDirectory(modelDir)) {
+      string energyDir = modelDir + "/" + energy;
+      if (!isDirectory(energyDir)) {
+        continue;
+      }
+      for (const string& primary : listDirectory(energyDir)) {
+        string primaryDir = energyDir + "/" + primary;
+        if (!isDirectory(primaryDir)) {
+          continue;
+        }
+        for (const string& name : listDirectory(primaryDir)) {
+          InputFile file;
+          string atmosphere;
+          if (!parseInputName(name, file, atmosphere)) {
+            continue;
+          }
+          file.path = primaryDir + "/" + name;
+          Group& group = groups[model + "/" + energy + "/" + primary + "/" + atmosphere];
+          group.model = model;
+          group.energy = energy;
+          group.primary = primary;
+          group.atmosphere = atmosphere;
+          group.bytes += fileSize(file.path);
+          group.files.push_back(file);
+        }
+      }
+    }
+  }
+
+  vector<Group> result;
+  for (auto& entry : groups) {
+    Group& group = entry.second;
+    stable_sort(group.files.begin(), group.files.end(),
+                [](const InputFile& a, const InputFile& b) { return a.showerID < b.showerID; });
+    result.push_back(std::move(group));
+  }
+  return result;
+}
+
+/// Shower IDs as ranges, "10005 10012-10020"
+static string formatIDs(const vector<long>& ids) {
+  ostringstream out;
+  for (size_t k = 0; k < ids.size(); ) {
+    size_t last = k;
+    while (last + 1 < ids.size() && ids[last + 1] == ids[last] + 1) {
+      last += 1;
+    }
+    out << (k > 0 ? " " : "") << ids[k];
+    if (last > k) {
+      out << "-" << ids[last];
+    }
+    k = last + 1;
+  }
+  return out.str();
+}
+
+/// Missing and duplicate shower IDs of a group, against aa0000 ... aa0000 + expected - 1 if expected
+/// is given, otherwise against the range of the IDs that are there
+static void checkShowerIDs(const Group& group, const CondenseOptions& opt, GroupResult& result) {
+  if (group.files.empty()) {
+    return;
+  }
+  vector<long> duplicates;
+  for (size_t k = 1; k < group.files.size(); ++k) {
+    if (group.files[k].showerID == group.files[k - 1].showerID &&
+        (duplicates.empty() || duplicates.back() != group.files[k].showerID)) {
+      duplicates.push_back(group.files[k].showerID);
+    }
+  }
+  long first = group.files.front().showerID;
+  long last = group.files.back().showerID;
+  if (opt.expected > 0) {
+    first = atol(group.atmosphere.c_str()) * 10000;
+    last = first + opt.expected - 1;
+  }
+  vector<long> missing;
+  size_t k = 0;
+  for (long id = first; id <= last; ++id) {
+    while (k < group.files.size() && group.files[k].showerID < id) {
+      k += 1;
+    }
+    if (k == group.files.size() || group.files[k].showerID != id) {
+      missing.push_back(id);
+    }
+  }
+  if (!missing.empty()) {
+    result.problems.push_back(to_string(missing.size()) + " missing shower IDs: " + formatIDs(missing));
+  }
+  if (!duplicates.empty()) {
+    result.problems.push_back(to_string(duplicates.size()) + " duplicate shower IDs: " + formatIDs(duplicates));
+  }
+}
+
+/// --------------------------------------------------------------------------------------------
+/// Merges the files of one group. Rows whose number of columns (or column names for column files)
+/// do not match the header are left out and reported.
+/// --------------------------------------------------------------------------------------------
+static void condenseGroup(const Group& group, const string& outDir, const CondenseOptions& opt, GroupResult& result) {
+  const string dir = outDir + "/" + group.model + "/" + group.energy;
+  result.output = dir + "/" + group.primary + "-" + group.energy + "-atm" + group.atmosphere + (opt.columns ? ".ccol" : ".txt");
+  if (!opt.overwrite && fileSize(result.output) > 0) {
+    result.skipped = true;
+    return;
+  }
+  checkShowerIDs(group, opt, result);
+
+  const size_t nColumns = opt.header.size();
+  string text = opt.headerLine + "\n";
+  vector<vector<double> > values(opt.columns ? nColumns : 0);
+  vector<ColumnSpec> specs;
+  vector<pair<string, string> > inputMetadata;
+
+  for (const InputFile& file : group.files) {
+    if (file.columns) {
+      vector<ColumnSpec> fileColumns;
+      vector<pair<string, string> > metadata;
+      vector<vector<double> > fileValues;
+      string error;
+      if (!readColumnFile(file.path, fileColumns, metadata, fileValues, error)) {
+        result.problems.push_back(error);
+        continue;
+      }
+      bool namesOK = (fileColumns.size() == nColumns);
+      for (size_t c = 0; c < fileColumns.size() && namesOK; ++c) {
+        namesOK = (fileColumns[c].name == opt.header[c]);
+      }
+      if (!namesOK) {
+        result.problems.push_back(file.name + ": " + to_string(fileColumns.size()) + " columns that do not match the header");
+        continue;
+      }
+      if (specs.empty()) {
+        specs = fileColumns;
+        inputMetadata = metadata;
+      }
+      const size_t rows = nColumns > 0 ? fileValues[0].size() : 0;
+      if (opt.columns) {
+        for (size_t c = 0; c < nColumns; ++c) {
+          values[c].insert(values[c].end(), fileValues[c].begin(), fileValues[c].end());
+        }
+      } else {
+        ostringstream out;
+        out.precision(10);
+        for (size_t r = 0; r < rows; ++r) {
+          for (size_t c = 0; c < nColumns; ++c) {
+            out << (c > 0 ? " " : "") << fileValues[c][r];
+          }
+          out << "\n";
+        }
+        text += out.str();
+      }
+      result.rows += rows;
+      continue;
+    }
+
+    ifstream in(file.path);
+    if (!in) {
+      result.problems.push_back("cannot read " + file.path);
+      continue;
+    }
+    string line;
+    size_t lineNumber = 0;
+    bool empty = true;
+    while (getline(in, line)) {
+      lineNumber += 1;
+      if (line.empty() || line[0] == '#') {
+        continue;
+      }
+      empty = false;
+      istringstream fields(line);
+      vector<string> row;
+      string field;
+      while (fields >> field) {
+        row.push_back(field);
+      }
+      if (row.size() != nColumns) {
+        result.problems.push_back(file.name + " line " + to_string(lineNumber) + ": " + to_string(row.size()) +
+                                  " columns, the header has " + to_string(nColumns));
+        continue;
+      }
+      if (opt.columns) {
+        for (size_t c = 0; c < nColumns; ++c) {
+          values[c].push_back(strtod(row[c].c_str(), nullptr));
+        }
+      } else {
+        text += line;
+        text += "\n";
+      }
+      result.rows += 1;
+    }
+    if (empty) {
+      result.problems.push_back(file.name + ": no rows");
+    }
+  }
+
+  if (mkdir((outDir + "/" + group.model).c_str(), 0755) != 0 && errno != EEXIST) {
+    result.problems.push_back("cannot create " + outDir + "/" + group.model);
+    return;
+  }
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    result.problems.push_back("cannot create " + dir);
+    return;
+  }
+
+  if (!opt.columns) {
+    ofstream out(result.output);
+    out << text;
+    if (!out) {
+      result.problems.push_back("cannot write " + result.output);
+    }
+    return;
+  }
+
+  // Types of the column files if there were any, text rows have no types and are kept as float64
+  if (specs.empty()) {
+    for (const string& name : opt.header) {
+      specs.push_back({name, ColumnType::Float64});
+    }
+  }
+  vector<pair<string, string> > metadata = {{"model", group.model}, {"energy_block", group.energy},
+                                            {"primary", group.primary}, {"atmosphere", group.atmosphere}};
+  for (const auto& entry : inputMetadata) {
+    bool known = false;
+    for (const auto& present : metadata) {
+      known = known || (present.first == entry.first);
+    }
+    if (!known) {
+      metadata.push_back(entry);
+    }
+  }
+  ColumnWriter writer(result.output, specs, metadata);
+  vector<double> row(nColumns);
+  for (size_t r = 0; r < result.rows; ++r) {
+    for (size_t c = 0; c < nColumns; ++c) {
+      row[c] = values[c][r];
+    }
+    writer.AddRow(row);
+  }
+  if (!writer.Close()) {
+    result.problems.push_back("cannot write " + result.output);
+  }
+}
+
+/// Column names of the header file, "#ParticleID, E(GeV), ..." in one line
+static bool readHeader(const string& fileName, CondenseOptions& opt) {
+  ifstream in(fileName);
+  string line;
+  while (getline(in, line) && line.find_first_not_of(" \t") == string::npos) {
+  }
+  if (line.empty()) {
+    return false;
+  }
+  opt.headerLine = line;
+  string names = (line[0] == '#') ? line.substr(1) : line;
+  istringstream fields(names);
+  string name;
+  while (getline(fields, name, ',')) {
+    size_t begin = name.find_first_not_of(" \t\r");
+    size_t end = name.find_last_not_of(" \t\r");
+    if (begin != string::npos) {
+      opt.header.push_back(name.substr(begin, end - begin + 1));
+    }
+  }
+  return !opt.header.empty();
+}
+
+int main(int argc, char* argv[]) {
+  CondenseOptions opt;
+  int nJobs = max(1u, thread::hardware_concurrency());
+  string headerFile;
+  vector<string> dirs;
+
+  for (int k = 1; k < argc; ++k) {
+    string arg = argv[k];
+    if (arg == "--header" && k + 1 < argc) {
+      headerFile = argv[++k];
+    } else if (arg == "--format" && k + 1 < argc) {
+      string format = argv[++k];
+      if (format != "text" && format != "columns") {
+        cerr << "Unknown format " << format << ", use text or columns" << endl;
+        return 1;
+      }
+      opt.columns = (format == "columns");
+    } else if (arg == "--jobs" && k + 1 < argc) {
+      nJobs = max(1, atoi(argv[++k]));
+    } else if (arg == "--expected" && k + 1 < argc) {
+      opt.expected = max(0, atoi(argv[++k]));
+    } else if (arg == "--overwrite") {
+      opt.overwrite = true;
+    } else if (arg.compare(0, 2, "--") == 0) {
+      cerr << "Unknown option " << arg << endl;
+      return 1;
+    } else {
+      dirs.push_back(arg);
+    }
+  }
+
+  if (dirs.size() != 2 || headerFile.empty()) {
+    cerr << "Usage is ./condenseOutput <DataDir> <OutputDir> --header <HeaderFile> [OPTIONS]\n";
+    cerr << "Merges <DataDir>/<model>/<energyblock>/<primary>/DATaannnn[.txt|.ccol] into\n";
+    cerr << "<OutputDir>/<model>/<energyblock>/<primary>-<energyblock>-atm<aa>.txt, rows in shower ID order\n";
+    cerr << "OPTIONS can be:\n";
+    cerr << "  --format F     text (default, header line and rows) or columns (binary column file, see columnFile.h)\n";
+    cerr << "  --jobs N       groups merged at the same time (default: number of cores)\n";
+    cerr << "  --expected N   showers per atmosphere, IDs aa0000 ... aa0000+N-1 are expected\n";
+    cerr << "                 (default: missing IDs are looked for between the smallest and largest ID)\n";
+    cerr << "  --overwrite    replace existing output files (default: skip those groups)\n";
+    return 1;
+  }
+  if (!readHeader(headerFile, opt)) {
+    cerr << "Cannot read the header " << headerFile << endl;
+    return 1;
+  }
+  const string& dataDir = dirs[0];
+  const string& outDir = dirs[1];
+  if (mkdir(outDir.c_str(), 0755) != 0 && errno != EEXIST) {
+    cerr << "Cannot create the output directory " << outDir << endl;
+    return 1;
+  }
+
+  auto start = chrono::steady_clock::now();
+  vector<Group> groups = scanDataDirectory(dataDir);
+  size_t nFiles = 0;
+  vector<size_t> sizes(groups.size());
+  for (size_t g = 0; g < groups.size(); ++g) {
+    nFiles += groups[g].files.size();
+    sizes[g] = groups[g].bytes;
+  }
+  cerr << groups.size() << " groups, " << nFiles << " files in " << dataDir << ", " << opt.header.size() << " columns" << endl;
+
+  vector<GroupResult> results(groups.size());
+  size_t nRows = 0;
+  size_t nProblems = 0;
+  runBatch(sizes, nJobs,
+    [&](size_t g) {
+      condenseGroup(groups[g], outDir, opt, results[g]);
+    },
+    [&](size_t g) {
+      const Group& group = groups[g];
+      const GroupResult& result = results[g];
+      cerr << group.model << "/" << group.energy << "/" << group.primary << " atm" << group.atmosphere << ": ";
+      if (result.skipped) {
+        cerr << result.output << " already exists, skipped (--overwrite replaces it)" << endl;
+        return true;
+      }
+      cerr << group.files.size() << " files, " << result.rows << " rows -> " << result.output << endl;
+      // The first few problems of a group, a whole group of broken files would drown the rest
+      const size_t kMaxListed = 10;
+      for (size_t k = 0; k < result.problems.size() && k < kMaxListed; ++k) {
+        cerr << "  " << result.problems[k] << endl;
+      }
+      if (result.problems.size() > kMaxListed) {
+        cerr << "  ... and " << result.problems.size() - kMaxListed << " more" << endl;
+      }
+      nRows += result.rows;
+      nProblems += result.problems.size();
+      return true;
+    });
+
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cerr << nRows << " rows in " << setprecision(3) << seconds << " s, " << nProblems << " problems" << endl;
+  return nProblems > 0 ? 2 : 0;
+}
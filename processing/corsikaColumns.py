@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+#
+# Reads the binary column files written by corsikaReader --columns (format described in columnFile.h)
+# into numpy arrays, one array per column.
+#
+# Usage as a module:
+#   from corsikaColumns import read_columns
+#   columns, metadata = read_columns("proton-17.0_17.5-atm01.ccol")
+#   xmax = columns["xmax"]
+#
+# Usage from the command line (prints the metadata, the columns and the number of rows):
+# python3 corsikaColumns.py <ColumnFile>
+#
+
+import struct
+import sys
+
+import numpy as np
+
+MAGIC = b"CORSCOL1"
+TYPES = {1: np.dtype("<i4"), 2: np.dtype("<f4"), 3: np.dtype("<f8")}
+
+
+def _read_exact(file, n):
+    data = file.read(n)
+    if len(data) != n:
+        raise IOError("column file is cut short")
+    return data
+
+
+def _read_uint32(file):
+    return struct.unpack("<I", _read_exact(file, 4))[0]
+
+
+def _read_string(file):
+    return _read_exact(file, _read_uint32(file)).decode("utf-8")
+
+
+def read_columns(filename):
+    """Returns ({name: numpy array}, {key: value}) of a column file"""
+    with open(filename, "rb") as file:
+        if file.read(8) != MAGIC:
+            raise IOError(filename + " is not a corsikaReader column file")
+
+        metadata = {}
+        for _ in range(_read_uint32(file)):
+            key = _read_string(file)
+            metadata[key] = _read_string(file)
+
+        names = []
+        types = []
+        for _ in range(_read_uint32(file)):
+            names.append(_read_string(file))
+            types.append(TYPES[struct.unpack("<B", _read_exact(file, 1))[0]])
+
+        groups = [[] for _ in names]
+        total = 0
+        while True:
+            rows = _read_uint32(file)
+            if rows == 0:
+                break
+            for c, dtype in enumerate(types):
+                groups[c].append(np.frombuffer(_read_exact(file, rows * dtype.itemsize), dtype=dtype))
+            total += rows
+
+        if struct.unpack("<Q", _read_exact(file, 8))[0] != total:
+            raise IOError(filename + ": the row count at the end does not match the row groups")
+
+    columns = {}
+    for c, name in enumerate(names):
+        columns[name] = np.concatenate(groups[c]) if groups[c] else np.empty(0, dtype=types[c])
+    return columns, metadata
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2:
+        print("Usage: python3 corsikaColumns.py <ColumnFile>")
+        sys.exit(1)
+    columns, metadata = read_columns(sys.argv[1])
+    for key, value in metadata.items():
+        print("# " + key + " = " + value)
+    nRows = len(next(iter(columns.values()))) if columns else 0
+    print("# " + str(nRows) + " rows")
+    print(", ".join(name + " (" + str(array.dtype) + ")" for name, array in columns.items()))
@@ -1,598 +1,1077 @@
 // To compile:
 // METHOD 1 (manual command line)
-// g++ -O0 -fbounds-check corsikaReader.cpp -o corsikaReader -std=c++11 -lm
+// g++ -O0 -fbounds-check *.cpp -o corsikaReader -std=c++11 -lm -lz -pthread
 // METHOD 2 (makefile)
 // Run command "make" in directory where this file exists (also make sure its Makefile exits in the same directory)
+// "make release" (optionally MARCH=native), "make pgo [PGO_SAMPLE=<DAT file>]" and "make sanitize" build the
+// optimized/checked variants next to the debug one, CMakeLists.txt has the same build types
+// "make bench" times the parser on synthetic files (benchmark/corsikaBenchmark.cpp)
+// "make condense" builds the merge tool for the per-file outputs (condense/condenseOutput.cpp)
 
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <string>
+#include <sstream>
 #include <algorithm>
+#include <map>
+#include <cstdlib>
+#include <cerrno>
 #include <math.h>
-#include <bitset>
-#include <climits>
+#include <chrono>
+#include <sys/stat.h>
+#include <unistd.h>
 using namespace std;
-#include <glob.h>
 
-#define PI 3.14159265
+#include "recordSource.h"
+#include "tarArchive.h"
+#include "showerParser.h"
+#include "batchRunner.h"
+#include "particleKernel.h"
+#include "longProfile.h"
+#include "columnFile.h"
+#include "particleExport.h"
+#include "batchManifest.h"
 
 // Used for defining the type of corsika simulation
 enum class SimType {Thinned, Standard};
 
-bool getBinary(float g, bool thinned) {
-  union
-  {
-    float input; // assumes sizeof(float) == sizeof(int)
-    int   output;
-  } data1;
-  union
-  {
-    float input; // assumes sizeof(float) == sizeof(int)
-    int   output;
-  } data1a;
-  union
-  {
-    float input; // assumes sizeof(float) == sizeof(int)
-    int   output;
-  } data2;
-
-  if (thinned) {
-    data1.input = 3.67252e-41; // must be this for thinned files
-  } else {
-    data1.input = 3.21346e-41; // must be this for non-thinned (standard) files
+/// Settings shared by all input files
+struct ReaderOptions {
+  int nrecstd = 0;
+  bool isThin = false;    // picks the record layout the parser is instantiated with (recordLayout.h)
+  bool perEvent = false;  // one row per shower instead of one per DAT file
+  size_t onlyEvent = 0;   // --event N, only the row of shower N (per event, counted from 1)
+  bool writeIndex = false;   // --write-index, <DAT file>.index of every plain DAT file
+  bool indexOnly = false;    // --index-only, just the index from the header sub-blocks, no rows
+  ReadSettings io;        // mmap, streaming or read-ahead (--async-io) of uncompressed files
+  int nThreads = 1;
+  RadialBins binning;     // radial bins of the nMu<Rm / nEM<Rm columns, 20 x 50 m by default
+  bool readLong = false;  // append the columns of the matching .long file to the row
+  double groundDepth = 870.;  // vertical depth of the observation level in g/cm2, for the .long columns
+  bool removeFinal20gcm2 = false;  // leave the last 20 g/cm2 of the profiles out of the fits
+  bool allFits = false;   // all GH/Andringa fit variants instead of the shifted GH and plain Andringa fit
+  std::string exportDir;  // --export, ground particles of every DAT file to <exportDir>/<DAT name>.particles.ccol
+  ExportFilter exportFilter;
+  BatchManifest* manifest = nullptr;  // --manifest, files read record by record save their state in it
+  double checkpointSeconds = 300.;    // --checkpoint, time between two saved states of a file
+  bool resync = false;    // --resync, skip over broken records to the next intact one instead of ending the file
+};
+
+/// R, sigmaR, L, sigmaL, Xmax, sigmaXmax of a fit, the column order of the python script
+static void writeFitRLXmax(ostream& out, const ProfileFit& f) {
+  out << " " << f.R << " " << f.RSigma << " " << f.L << " " << f.LSigma << " " << f.Xmax << " " << f.XmaxSigma;
+}
+
+/// Xmax, sigmaXmax, R, sigmaR, L, sigmaL, the order of the Andringa columns with --all-fits
+static void writeFitXmaxRL(ostream& out, const ProfileFit& f) {
+  out << " " << f.Xmax << " " << f.XmaxSigma << " " << f.R << " " << f.RSigma << " " << f.L << " " << f.LSigma;
+}
+
+/// Output of one DAT file, the .long columns are added to the row when its profiles are fitted
+struct FileOutput {
+  std::string name;                 // input file, the member name for the DAT files of an archive
+  vector<std::string> rows;         // up to the nEM<Rm columns, without the end of line
+  vector<size_t> rowShowers;        // --per-event: the shower (EVTH) of each row, for its .long columns
+  std::string spectra;
+  vector<vector<double> > values;   // the rows up to the nEM<Rm columns as numbers for --columns, first shower only
+  vector<double> zeniths;           // of every EVTH, for the ground depth of the profiles
+  vector<LongProfile> profiles;     // one per shower of the row
+  vector<LongSummary> summaries;
+  std::string completes;            // --manifest: this input is finished once the outputs before are written
+  bool completesOK = true;
+};
+
+/// Read block = record, false at the first broken record
+template <class Layout>
+static bool processRecords(RecordSource& source, ParseState& state, ShowerCounters& c) {
+  while (const float* sdata = source.Next()) { /// get full block of data at once
+    if ( !processRecord<Layout>(sdata, state, c) ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// processRecords with the options of a batch, for files read record by record:
+/// - with a manifest (checkpoint) it continues from the saved state of the file if there is one (the
+///   records before it are skipped, compressed files still have to be decompressed up to it) and saves
+///   the state every opt.checkpointSeconds
+/// - with --resync a broken record does not end the file: the bytes up to the next record with both
+///   record length markers right are reported as lost and parsing goes on there. Returns false if
+///   bytes were lost.
+template <class Layout>
+static bool processRecordsRecovering(RecordSource& inner, const std::string& file_, const ReaderOptions& opt,
+                                     bool checkpoint, ParseState& state, ShowerCounters& c) {
+  ResyncRecordSource source(inner, Layout::recordBytes, recordMarkers(Layout::weighted));
+  string stateName;
+  if (checkpoint) {
+    stateName = opt.manifest->StateName(file_);
+    const ManifestEntry* entry = opt.manifest->Find(file_);
+    uint64_t resumeOffset;
+    if (entry && entry->status == "checkpoint" && loadParseState(stateName, file_, Layout::recordBytes, resumeOffset, state, c) &&
+        !source.SkipTo(resumeOffset)) {
+      return false;
+    }
   }
 
-  data1a.input = 4.59037e-41;
-  data2.input = g;
+  typedef chrono::steady_clock Clock;
+  Clock::time_point lastSave = Clock::now();
+  while (const float* sdata = source.Next()) {
+    if (opt.resync && !recordIntact<Layout>(sdata)) {
+      uint64_t lostBegin, lostEnd;
+      bool found = source.Resync(lostBegin, lostEnd);
+      cerr << "Lost bytes " << lostBegin << "-" << lostEnd << " of " << file_ << " (" << lostEnd - lostBegin << " bytes), "
+           << (found ? "continuing at the next record" : "no record after them") << endl;
+      state.lostBytes = true;
+      if (state.index) {
+        state.index->broken = true;
+      }
+      continue;
+    }
+    if ( !processRecord<Layout>(sdata, state, c) ) {
+      return false;
+    }
+    if (checkpoint && chrono::duration<double>(Clock::now() - lastSave).count() >= opt.checkpointSeconds) {
+      if (saveParseState(stateName, file_, Layout::recordBytes, source.Offset() + Layout::recordBytes, state, c)) {
+        opt.manifest->Checkpoint(file_, state.record);
+      } else {
+        cerr << "Cannot save the state of " << file_ << " to " << stateName << endl;
+      }
+      lastSave = Clock::now();
+    }
+  }
+  uint64_t leftoverBegin;
+  if (size_t leftover = source.Leftover(leftoverBegin)) {
+    cerr << "Lost bytes " << leftoverBegin << "-" << leftoverBegin + leftover << " of " << file_ << " (" << leftover
+         << " bytes), less than a record at the end" << endl;
+    state.lostBytes = true;
+  }
+  return !state.lostBytes;
+}
 
-  std::bitset<sizeof(float) * CHAR_BIT> bits1(data1.output);
-  std::bitset<sizeof(float) * CHAR_BIT> bits1a(data1a.output);
-  std::bitset<sizeof(float) * CHAR_BIT> bits2(data2.output);
-  if ((bits1 == bits2) || (bits1a == bits2)) {
-    return true;
+/// All records of a file into state and c, false if the file is broken. indexFile is the DAT file
+/// whose .index is used and written, empty for archive members.
+template <class Layout>
+static bool readRecords(RecordSource& source, const std::string& file_, const std::string& indexFile,
+                        const ReaderOptions& opt, ParseState& state, ShowerCounters& c) {
+  // The exporter writes the particles in file order, so a file is not split into record ranges then.
+  // Per event the showers are processed in parallel instead of record ranges, on the shower boundaries
+  // of the .index file if there is a valid one. --resync goes through the file record by record.
+  const bool byEvent = opt.perEvent && (opt.nThreads > 1 || opt.onlyEvent > 0) && !opt.resync;
+  if (source.RandomAccess() && !state.exporter && (byEvent || opt.indexOnly)) {
+    RecordIndex index;
+    string error;
+    bool fromFile = !indexFile.empty() && readRecordIndex(indexFile, Layout::recordBytes, index, error) && !index.broken;
+    if (!fromFile) {
+      indexRecords<Layout>(source, index);
+    }
+    if (opt.writeIndex && !fromFile && !indexFile.empty() && !writeRecordIndex(indexFile, Layout::recordBytes, Layout::subBlockWords, index)) {
+      cerr << "Cannot write the index " << indexNameOf(indexFile) << endl;
+    }
+    if (opt.indexOnly) {
+      state.nrShow = index.nrShow;
+      state.EVTEcnt = index.nEVTE;
+      return !index.broken;
+    }
+    return processEventsParallel<Layout>(source, index, opt.nThreads, opt.onlyEvent, state, c);
   }
 
-  return false;
+  RecordIndex index;
+  if (opt.writeIndex && !indexFile.empty()) {
+    state.index = &index;
+  }
+  const bool checkpoint = opt.manifest && !indexFile.empty() && !state.exporter && !state.index;
+  bool fileOK;
+  if (opt.nThreads > 1 && source.RandomAccess() && !state.exporter && !opt.perEvent && !opt.resync) {
+    fileOK = processRecordsParallel<Layout>(source, opt.nThreads, state, c);
+  } else if (opt.resync || checkpoint) {
+    fileOK = processRecordsRecovering<Layout>(source, file_, opt, checkpoint, state, c);
+  } else {
+    fileOK = processRecords<Layout>(source, state, c);
+  }
+  if (state.index) {
+    index.nrShow = state.nrShow;
+    index.nEVTE = state.EVTEcnt;
+    if (!writeRecordIndex(indexFile, Layout::recordBytes, Layout::subBlockWords, index)) {
+      cerr << "Cannot write the index " << indexNameOf(indexFile) << endl;
+    }
+    state.index = nullptr;
+  }
+  return fileOK;
+}
+
+/// Text row, column values and spectra of one set of counters. The text row starts with the primary,
+/// energy, zenith and azimuth of every shower in headers, the column values with those of the first.
+static void addRow(const vector<EventHeader>& headers, ShowerCounters& c, const std::string& title, bool withSpectra,
+                   FileOutput& result) {
+  ostringstream out;
+  for (size_t h = 0; h < headers.size(); ++h) {
+    const EventHeader& event = headers[h];
+    out << event.primaryID << " " << event.primaryEnergy << " " << event.zenith << " " << event.azimuth << " ";
+  }
+
+  c.Round();
+
+  // The observable columns nMu ... nEM<1000m, integer columns are printed as such
+  vector<ColumnSpec> columns;
+  vector<double> values;
+  c.Columns(columns);
+  c.Values(values);
+  for (size_t v = 0; v < values.size(); ++v) {
+    if (v > 0) {
+      out << " ";
+    }
+    if (columns[v].type == ColumnType::Int32) {
+      out << (long) values[v];
+    } else {
+      out << values[v];
+    }
+  }
+  result.rows.push_back(out.str());
+
+  // Same columns for --columns, a row there always has a single shower
+  EventHeader first = headers.empty() ? EventHeader() : headers[0];
+  result.values.push_back({first.primaryID, first.primaryEnergy, first.zenith, first.azimuth});
+  result.values.back().insert(result.values.back().end(), values.begin(), values.end());
+
+  if (withSpectra) {
+    ostringstream spectra;
+    spectra << "# " << title << "\n# muons vs core distance (m): bin edgeLeft edgeRight content center\n";
+    c.muLateral.Dump(spectra);
+    spectra << "# e+/- vs core distance (m): bin edgeLeft edgeRight content center\n";
+    c.emLateral.Dump(spectra);
+    spectra << "# muons vs kinetic energy (GeV): bin edgeLeft edgeRight content center\n";
+    c.muEnergy.Dump(spectra);
+    result.spectra += spectra.str();
+  }
 }
 
 /// --------------------------------------------------------------------------------------------
-/// MAIN PART - READING.....
+/// Parses the records of a single DAT file into its output row (one per shower with --per-event),
+/// returns false if the file is broken
+/// If spectra are enabled the muon/EM spectra of the file (of every shower) are dumped as well
 /// --------------------------------------------------------------------------------------------
+static bool parseSource(RecordSource& source, const std::string& file_, const std::string& indexFile,
+                        const ReaderOptions& opt, bool withSpectra, FileOutput& result) {
+  /// init variables
+  bool BROKENflag = false;
+  ParseState state;
+  state.perEvent = opt.perEvent;
+  ShowerCounters c(opt.binning);
+  if (withSpectra) {
+    c.EnableSpectra();
+  }
 
+  std::unique_ptr<ParticleExporter> exporter;
+  if (!opt.exportDir.empty()) {
+    string base = stripCompressionSuffix(result.name);
+    base = base.substr(base.rfind('/') + 1);
+    string exportName = opt.exportDir + "/" + base + ".particles.ccol";
+    exporter.reset(new ParticleExporter(exportName, opt.exportFilter,
+                                        {{"source", file_}, {"simulation", opt.isThin ? "thinned" : "standard"}}));
+    if ( !exporter->Good() ) {
+      cerr << "Cannot write the particles of " << file_ << " to " << exportName << endl;
+      exporter.reset();
+    }
+    state.exporter = exporter.get();
+  }
 
-int main (int argc, char *argv[]) {
+  BROKENflag = !(opt.isThin ? readRecords<ThinnedLayout>(source, file_, indexFile, opt, state, c)
+                            : readRecords<StandardLayout>(source, file_, indexFile, opt, state, c));
 
-  if (argc < 3) {
-    cerr << "--------------------------------------------------------------------------------\n";
-    cerr << "This program counts the muons and e+/- in the air shower at different distances:\n";
-    cerr << "You must give the input filename and type of CORSIKA file (thinned or standard)\n";
-    cerr << "Usage is ./corsikaReader <InputFile1> [InputFile2 InputFile3 ...] --FILE_FLAG\n";
-    cerr << "--FILE_FLAG can be: --thinned or --standard\n";
-    cerr << "--------------------------------------------------------------------------------\n";
+  if (exporter && !exporter->Close()) {
+    cerr << "Error writing the particles of " << file_ << endl;
+  }
 
-    return 0;
+  if (opt.indexOnly) {
+    // no row
+  } else if (opt.perEvent) {
+    // Showers without their EVTE (broken files) give no row
+    if (opt.onlyEvent > state.headers.size()) {
+      cerr << "No shower " << opt.onlyEvent << " in " << file_ << endl;
+    }
+    for (EventCounters& event : state.events) {
+      if (opt.onlyEvent > 0 && event.header + 1 != opt.onlyEvent) {
+        continue;
+      }
+      ostringstream title;
+      title << file_ << ", shower " << event.header + 1;
+      addRow({state.headers[event.header]}, event.counters, title.str(), withSpectra, result);
+      result.rowShowers.push_back(event.header);
+    }
+  } else {
+    addRow(state.headers, c, file_, withSpectra, result);
+  }
+  for (size_t h = 0; h < state.headers.size(); ++h) {
+    result.zeniths.push_back(state.headers[h].zenith);
   }
 
-  std::string filePath = argv[1];
-  std::string fileFlag = argv[argc - 1];
+  return !( BROKENflag || !(state.EVTEcnt == state.nrShow) );
+}
 
-  SimType mode;
+/// Profiles of every shower from the .long file, the RowWriter fits them and writes their columns
+static void attachProfiles(vector<LongProfile>& profiles, bool readOK, const std::string& longName,
+                           const ReaderOptions& opt, FileOutput& result) {
+  if (!readOK) {
+    cerr << "Cannot read the longitudinal profile " << longName << endl;
+  } else if (profiles.size() < result.zeniths.size()) {
+    cerr << "Not enough showers in the longitudinal profile " << longName << endl;
+  }
+  for (size_t h = 0; h < result.zeniths.size() && h < profiles.size(); ++h) {
+    result.summaries.push_back(summarizeProfile(profiles[h], result.zeniths[h], opt.groundDepth));
+    result.profiles.push_back(std::move(profiles[h]));
+  }
+}
 
-  if (fileFlag == "--thinned") {
-    mode = SimType::Thinned;   // thinned corsika file
-  } else if (fileFlag == "--standard") {
-    mode = SimType::Standard;   // standard corsika file
-  } else {
-    cerr << "-----------------------------------------------------------------------------\n";
-    cerr << "Invalid file flag given!\n";
-    cerr << "Usage is ./corsikaReader <InputFile1> [InputFile2 InputFile3 ...] --FILE_FLAG\n";
-    cerr << "--FILE_FLAG must be either: --thinned or --standard\n";
-    cerr << "-----------------------------------------------------------------------------\n";
-    return 0;
+/// <file>.long of a DAT file. For a compressed DAT file (DAT000001.gz) that is DAT000001.long,
+/// which may itself be compressed (DAT000001.long.gz, .bz2 or .zst).
+static bool readProfilesOf(const std::string& file_, vector<LongProfile>& profiles, std::string& longName) {
+  longName = stripCompressionSuffix(file_) + ".long";
+  if (readLongFile(longName, profiles) || longName == file_ + ".long") {
+    return !profiles.empty();
   }
+  const char* suffixes[] = {".gz", ".bz2", ".zst"};
+  for (const char* suffix : suffixes) {
+    string text;
+    if (readCompressedFile(longName + suffix, text)) {
+      longName += suffix;
+      istringstream in(text);
+      return readLongProfiles(in, profiles);
+    }
+  }
+  return false;
+}
 
-  // Ternary operations
-  // If mode is Thinned, then use "thinned corsika" record size, else use "standard corsika" record size
-  const int nrecstd = (mode == SimType::Thinned) ? 26216 : 22940;
-  const int nsblstd = (mode == SimType::Thinned) ? 312 : 273;
+/// A DAT file (plain or compressed) and with --long its <file>.long
+static bool parseFile(const std::string& file_, const ReaderOptions& opt, bool withSpectra, FileOutput& result) {
+  std::unique_ptr<RecordSource> source = openRecordSource(file_, opt.nrecstd, opt.io);
+  // cerr << "fileName -> " << file_ << endl;
+  bool fileOK = parseSource(*source, file_, file_, opt, withSpectra, result);
+  if ( !source->Error().empty() ) {
+    cerr << source->Error() << endl;
+    fileOK = false;
+  }
 
-  // Other constants
-  const int numbstd = nrecstd / 4;     // = 6554 for "thinned corsika", = 5735 for "standard corsika"
-  float sdata[numbstd];                // to read data for a single corsika record
+  if (opt.readLong && !opt.indexOnly) {
+    vector<LongProfile> profiles;
+    string longName;
+    bool readOK = readProfilesOf(file_, profiles, longName);
+    attachProfiles(profiles, readOK, longName, opt, result);
+  }
+  return fileOK;
+}
 
-  // Constant for ternary operation to define particle weights in data block
-  const bool isThin = (mode == SimType::Thinned) ? true : false;
+/// --------------------------------------------------------------------------------------------
+/// Reads the DAT files (DATnnnnnn members) of a .tar(.gz) archive straight out of the compressed
+/// stream, one output row each in archive order. With --long the matching .long members are
+/// kept in memory, they may come before or after their DAT file.
+/// --------------------------------------------------------------------------------------------
+static bool parseArchive(const std::string& archive, const ReaderOptions& opt, bool withSpectra,
+                         vector<FileOutput>& results) {
+  CompressedStream stream(archive);
+  TarReader tar(stream);
+  bool archiveOK = true;
+  map<string, vector<LongProfile> > longProfiles;
+
+  string name;
+  size_t size;
+  while (tar.NextMember(name, size)) {
+    string base = name.substr(name.rfind('/') + 1);
+    if (base.size() > 5 && base.compare(base.size() - 5, 5, ".long") == 0) {
+      if (opt.readLong) {
+        string text(size, '\0');
+        text.resize(tar.Read(&text[0], size));
+        istringstream in(text);
+        readLongProfiles(in, longProfiles[base.substr(0, base.size() - 5)]);
+      }
+    } else if (base.compare(0, 3, "DAT") == 0 && base.find('.') == string::npos) {
+      TarRecordSource source(tar, opt.nrecstd);
+      results.push_back(FileOutput());
+      results.back().name = name;
+      archiveOK &= parseSource(source, archive + ":" + name, "", opt, withSpectra, results.back());
+    }
+  }
 
-  vector<string> possible_headers = {"RUNH", "EVTH", "LONG", "EVTE", "RUNE"};
+  if (tar.Broken() || stream.Failed()) {
+    cerr << "Archive " << archive << " is truncated or corrupt" << (stream.Failed() ? ": " + stream.Error() : "") << endl;
+    archiveOK = false;
+  }
+  if (results.empty()) {
+    cerr << "No DAT file in the archive " << archive << endl;
+    return false;
+  }
 
-  glob_t glob_result;
-  glob(filePath.c_str(), GLOB_TILDE, NULL, &glob_result);
+  if (opt.readLong) {
+    for (FileOutput& result : results) {
+      string base = result.name.substr(result.name.rfind('/') + 1);
+      auto found = longProfiles.find(base);
+      vector<LongProfile> none;
+      attachProfiles((found != longProfiles.end()) ? found->second : none, found != longProfiles.end() && !found->second.empty(),
+                     archive + ":" + base + ".long", opt, result);
+    }
+  }
+  return archiveOK;
+}
 
-  /// init variables
-  bool BROKENflag = false;
-  int EVTEcnt = 0;
-  int nrShow = 0;
-  float primaryID, primaryEnergy; 
-  double zenith, azimuth, azimuthCorr;
-  int numObsLevels, CurvedObsLevFlag;
-  double obslev;
-  primaryID = 0.;
-  primaryEnergy = 0.;
-  zenith = 0.;
-  azimuth = 0.;
-  azimuthCorr = 0.;
-  CurvedObsLevFlag = 0;
+/// A DAT file or a tar archive of DAT files
+static bool parseInput(const std::string& input, const ReaderOptions& opt, bool withSpectra, vector<FileOutput>& results) {
+  if (isTarArchiveName(input)) {
+    return parseArchive(input, opt, withSpectra, results);
+  }
+  results.push_back(FileOutput());
+  results.back().name = input;
+  return parseFile(input, opt, withSpectra, results.back());
+}
 
-  /// --------------------------------------------------------------------------------------------
-  /// THE MAIN LOOP
-  /// --------------------------------------------------------------------------------------------
-  /// This reads all input files one by one
-  for (int k = 1; k < argc - 1; ++k) {
-    EVTEcnt = 0;
-    BROKENflag = false;
-
-    std::string file_ = argv[k];
-
-    if (!(file_.find(".long") != std::string::npos)) {
-
-      ifstream is (file_, ifstream::binary);
-      // cerr << "fileName -> " << file_ << endl;
-
-      float nMuons = 0.;
-      float nMuons1 = 0.;
-      float nMuons500 = 0.;
-      float nMuons1000 = 0.;
-
-      int muonThin1 = 0;
-      float thinWeight1 = 0.;
-
-      int muonThin500 = 0;
-      float thinWeight500 = 0.;
-
-      float nMuDist50 = 0.;
-      float nMuDist100 = 0.;
-      float nMuDist150 = 0.;
-      float nMuDist200 = 0.;
-      float nMuDist250 = 0.;
-      float nMuDist300 = 0.;
-      float nMuDist350 = 0.;
-      float nMuDist400 = 0.;
-      float nMuDist450 = 0.;
-      float nMuDist500 = 0.;
-      float nMuDist550 = 0.;
-      float nMuDist600 = 0.;
-      float nMuDist650 = 0.;
-      float nMuDist700 = 0.;
-      float nMuDist750 = 0.;
-      float nMuDist800 = 0.;
-      float nMuDist850 = 0.;
-      float nMuDist900 = 0.;
-      float nMuDist950 = 0.;
-      float nMuDist1000 = 0.;
-
-      float nEM = 0;
-
-      float nEMDist50 = 0.;
-      float nEMDist100 = 0.;
-      float nEMDist150 = 0.;
-      float nEMDist200 = 0.;
-      float nEMDist250 = 0.;
-      float nEMDist300 = 0.;
-      float nEMDist350 = 0.;
-      float nEMDist400 = 0.;
-      float nEMDist450 = 0.;
-      float nEMDist500 = 0.;
-      float nEMDist550 = 0.;
-      float nEMDist600 = 0.;
-      float nEMDist650 = 0.;
-      float nEMDist700 = 0.;
-      float nEMDist750 = 0.;
-      float nEMDist800 = 0.;
-      float nEMDist850 = 0.;
-      float nEMDist900 = 0.;
-      float nEMDist950 = 0.;
-      float nEMDist1000 = 0.;
-
-      /// Read block = record --------------------------------------------------------
-      while ( is.read((char*)&sdata, sizeof(sdata)) ) { /// get full block of data at once
-        if ( !getBinary( sdata[0], isThin ) ) { /// skip the first  record length sdata[0]
-          cerr << "This file is corrupted, this is not a record length - beginning of block!" << endl;
-          BROKENflag = true;
-          break;
-        }
-        /// iterate over 21 sub block inside this block
-        for (int j = 0; j < 21; j++) {
-          string head_word = (string) (char *) &sdata[j * nsblstd + 1];
-          head_word = head_word.substr (0, 4); /// dirty hack!
-          if ( find( possible_headers.begin(), possible_headers.end(), head_word ) != possible_headers.end() ) {
-            if (head_word == "RUNH") {
-              nrShow = sdata[j * nsblstd + 93];
-            } else if (head_word == "EVTH") {
-              ///  Reading primary type and energy
-              primaryID = sdata[j * nsblstd + 1 + 2];
-              primaryEnergy = sdata[j * nsblstd + 1 + 3];
-              zenith = sdata[j * nsblstd + 11];
-              azimuth = sdata[j * nsblstd + 12];
-              azimuthCorr = azimuth - PI;
-              numObsLevels = sdata[j * nsblstd + 47]; // Number of observation levels
-              obslev = sdata[j * nsblstd + 47 + 1]; // Height of first observation level in cm (will only be 1 obslev if curved surface)
-              CurvedObsLevFlag = sdata[j * nsblstd + 168]; // == 1 if observation level is curved, == 0 if flat
-              cout << primaryID << " " << primaryEnergy << " " << zenith << " " << azimuth << " ";
-            } else if (head_word == "EVTE") {
-              EVTEcnt += 1;
-            }
-          }
-          else { /// READ DATA -> iterate every 7th position
-            for (int i = j * nsblstd + 1; i <= (j * nsblstd + nsblstd); i += 8 ) {
-              float particle_id = sdata[i];
-              int idpa =  (int)particle_id / 1000;
-              /// ensure you grab only MUONS
-              if ( idpa == 5 || idpa == 6 ) {
-                float px = sdata[i + 1];
-                float py = sdata[i + 2];
-                float pz = sdata[i + 3];
-                float x  = sdata[i+4];
-                float y  = sdata[i+5];
-                // float t  = sdata[i+6];
-
-                // Set weights from data block for thinned showers, else set weights to 1.0 for standard showers
-                float w = isThin ? sdata[i+7] : 1.0;
-
-                // Some variables for each muon that might be useful in the future...
-                //~ double pz_norm = -pz/sqrt( pz*pz + py*py + px*px );
-                //~ double theta   = acos( pz_norm); // in degress
-                //~ double zenith  = acos(-pz_norm); // in rad
-
-                double massMu = 0.105658357;
-
-                /// Kinetic energy  !!!
-                double ekinMu = sqrt ( px * px + py * py + pz * pz + massMu * massMu) - (massMu) ;
-
-                double dist;
-
-                // Distance to shower axis converted to meters, shower axis coords. are defined as (0, 0, OBSLEV)
-                // r_shower = sqrt (|d|^2 - (d . n)^2)
-                // d is the vector from particle position to shower core, (x - 0, y - 0, OBSLEV - OBSLEV) = (x, y, 0)
-                // n is the unit vector along the shower axis, n = (sin(zenith)*cos(azimuth), sin(zenith)*sin(azimuth), -cos(zenith))
-                if ( CurvedObsLevFlag == 1 ) {
-                  // If observation level is curved then account for curvature of Earth's surface in distance calculation
-                  // Need to define necessary variables first
-                  double radEarthPlusObslev = 637131500. + obslev;
-
-                  double theta = sqrt ( x*x + y*y ) / radEarthPlusObslev;
-                  double phi = atan2 (y, x);
-
-                  double D = radEarthPlusObslev * sin(theta);
-
-                  double xCart = D * cos(phi);
-                  double yCart = D * sin(phi);
-                  double zCart = radEarthPlusObslev * cos(theta) - 637131500.;
-
-                  dist = sqrt ( (xCart - 0.)*(xCart - 0.) + (yCart - 0.)*(yCart - 0.)
-                         + (zCart - obslev)*(zCart - obslev) ) / 100. ;           
-                } else {
-                  // If observation level is not curved then just calculate distance for a flat surface
-                  dist = sqrt ( x*x + y*y - x*x*sin(zenith)*sin(zenith)*cos(azimuth)*cos(azimuth)
-                         - y*y*sin(zenith)*sin(zenith)*sin(azimuth)*sin(azimuth)
-                         - 2*x*y*sin(zenith)*sin(zenith)*cos(azimuth)*sin(azimuth) ) / 100. ;
-                }
-
-                nMuons += w;
-
-                if ( ekinMu > 1. ) {
-                  nMuons1 += w;
-
-                  // For testing thinning effects
-                  if ( w > 1. ) {
-                    muonThin1 += 1;
-                    thinWeight1 += w;
-                  }
-                }
-
-                if ( ekinMu > 500. ) {
-                  nMuons500 += w;
-
-                  // For testing thinning effects
-                  if (w > 1. ) {
-                    muonThin500 += 1;
-                    thinWeight500 += w;
-                  }
-                }
-
-                if ( ekinMu > 1000. ) {
-                  nMuons1000 += w;
-                }
-
-                if ( dist <= 50. ) {
-                  nMuDist50 += w;
-                }
-
-                if ( dist <= 100. ) {
-                  nMuDist100 += w;
-                }
-
-                if ( dist <= 150. ) {
-                  nMuDist150 += w;
-                }
-
-                if ( dist <= 200. ) {
-                  nMuDist200 += w;
-                }
-
-                if ( dist <= 250. ) {
-                  nMuDist250 += w;
-                }
-
-                if ( dist <= 300. ) {
-                  nMuDist300 += w;
-                }
-
-                if ( dist <= 350. ) {
-                  nMuDist350 += w;
-                }
-
-                if ( dist <= 400. ) {
-                  nMuDist400 += w;
-                }
-
-                if ( dist <= 450. ) {
-                  nMuDist450 += w;
-                }
-
-                if ( dist <= 500. ) {
-                  nMuDist500 += w;
-                }
-
-                if ( dist <= 550. ) {
-                  nMuDist550 += w;
-                }
-
-                if ( dist <= 600. ) {
-                  nMuDist600 += w;
-                }
-
-                if ( dist <= 650. ) {
-                  nMuDist650 += w;
-                }
-
-                if ( dist <= 700. ) {
-                  nMuDist700 += w;
-                }
-
-                if ( dist <= 750. ) {
-                  nMuDist750 += w;
-                }
-
-                if ( dist <= 800. ) {
-                  nMuDist800 += w;
-                }
-
-                if ( dist <= 850. ) {
-                  nMuDist850 += w;
-                }
-
-                if ( dist <= 900. ) {
-                  nMuDist900 += w;
-                }
-
-                if ( dist <= 950. ) {
-                  nMuDist950 += w;
-                }
-
-                if ( dist <= 1000. ) {
-                  nMuDist1000 += w;
-                }
-
-              // Now do case for electrons + positrons
-              } else if ( idpa == 2 || idpa == 3) {
-                //float px = sdata[i + 1];
-                //float py = sdata[i + 2];
-                //float pz = sdata[i + 3];
-                float x  = sdata[i+4];
-                float y  = sdata[i+5];
-                // float t  = sdata[i+6];
-
-                // Set weights from data block for thinned showers, else set weights to 1.0 for standard showers
-                float wEM = isThin ? sdata[i+7] : 1.0;
-
-                double distEM;
-
-                // Distance to shower axis converted to meters, shower axis coords. are defined as (0, 0, 0)
-                if ( CurvedObsLevFlag == 1 ) {
-                  // If observation level is curved then account for curvature of Earth's surface in distance calculation
-                  // Need to define necessary variables first
-                  double radEarthPlusObslev = 637131500. + obslev;
+/// --------------------------------------------------------------------------------------------
+/// --verify: one tab separated line per DAT file from its record markers and header sub-blocks
+/// --------------------------------------------------------------------------------------------
+/// status is ok, corrupt (a record length marker is wrong, the record starts at bad_offset),
+/// truncated (bytes after the last complete record, or no RUNE), incomplete (not as many EVTE as
+/// showers announced by the RUNH) or unreadable (missing file, damaged compressed data or archive)
+static const char* kVerifyHeader = "# file\tstatus\trecords\tbad_offset\ttrailing_bytes\trunh\tevth\tlong\tevte\trune\tshowers";
+
+static std::string verifyLine(const std::string& name, RecordSource& source, const ReaderOptions& opt, bool readable) {
+  VerifyReport report;
+  if (opt.isThin) {
+    verifyRecords<ThinnedLayout>(source, report);
+  } else {
+    verifyRecords<StandardLayout>(source, report);
+  }
+  if ( !source.Error().empty() ) {
+    cerr << source.Error() << endl;
+    readable = false;
+  }
 
-                  double theta = sqrt ( x*x + y*y ) / radEarthPlusObslev;
-                  double phi = atan2 (y, x);
+  const char* status = "ok";
+  if (!readable) {
+    status = "unreadable";
+  } else if (report.broken) {
+    status = "corrupt";
+  } else if (report.trailingBytes > 0 || report.nRUNE == 0) {
+    status = "truncated";
+  } else if (report.nEVTE != report.nrShow) {
+    status = "incomplete";
+  }
+  ostringstream line;
+  line << name << "\t" << status << "\t" << report.records << "\t";
+  if (report.broken) {
+    line << (unsigned long long) report.records * opt.nrecstd;
+  } else {
+    line << "-";
+  }
+  line << "\t" << report.trailingBytes << "\t" << report.nRUNH << "\t" << report.nEVTH << "\t" << report.nLONG
+       << "\t" << report.nEVTE << "\t" << report.nRUNE << "\t" << report.nrShow;
+  return line.str();
+}
 
-                  double D = radEarthPlusObslev * sin(theta);
-
-                  double xCart = D * cos(phi);
-                  double yCart = D * sin(phi);
-                  double zCart = radEarthPlusObslev * cos(theta) - 637131500.;
-
-                  distEM = sqrt ( (xCart - 0.)*(xCart - 0.) + (yCart - 0.)*(yCart - 0.)
-                         + (zCart - obslev)*(zCart - obslev) ) / 100. ;           
-                } else {
-                  // If observation level is not curved then just calculate distance for a flat surface
-                  distEM = sqrt ( x*x + y*y - x*x*sin(zenith)*sin(zenith)*cos(azimuth)*cos(azimuth)
-                         - y*y*sin(zenith)*sin(zenith)*sin(azimuth)*sin(azimuth)
-                         - 2*x*y*sin(zenith)*sin(zenith)*cos(azimuth)*sin(azimuth) ) / 100. ;
-                }
-
-                nEM += wEM;
+/// Lines of a DAT file or of the DAT files of an archive (archive:member), plus one for the archive
+/// itself if it cannot be read to its end
+static vector<std::string> verifyInput(const std::string& input, const ReaderOptions& opt) {
+  vector<string> lines;
+  if (isTarArchiveName(input)) {
+    CompressedStream stream(input);
+    TarReader tar(stream);
+    string name;
+    size_t size;
+    while (tar.NextMember(name, size)) {
+      string base = name.substr(name.rfind('/') + 1);
+      if (base.compare(0, 3, "DAT") == 0 && base.find('.') == string::npos) {
+        TarRecordSource source(tar, opt.nrecstd);
+        lines.push_back(verifyLine(input + ":" + name, source, opt, true));
+      }
+    }
+    if (tar.Broken() || stream.Failed() || lines.empty()) {
+      if (stream.Failed()) {
+        cerr << "Archive " << input << ": " << stream.Error() << endl;
+      }
+      lines.push_back(input + "\tunreadable\t-\t-\t-\t-\t-\t-\t-\t-\t-");
+    }
+    return lines;
+  }
+  uint64_t size;
+  int64_t mtime;
+  bool readable = fileStamp(input, size, mtime);
+  std::unique_ptr<RecordSource> source = openRecordSource(input, opt.nrecstd, opt.io);
+  lines.push_back(verifyLine(input, *source, opt, readable));
+  return lines;
+}
 
-                if ( distEM <= 50. ) {
-                  nEMDist50 += wEM;
-                }
+/// --------------------------------------------------------------------------------------------
+/// Columns of a row for --columns, named like cleanup/CorsikaParser_OutputHeader.txt
+/// --------------------------------------------------------------------------------------------
+static const char* kFitNames[2][NumFitVariants][6] = {
+  {{"RFit", "sigmaRFit", "LFit", "sigmaLFit", "XmaxFit", "sigmaXmaxFit"},
+   {"RFitShift", "sigmaRFitShift", "LFitShift", "sigmaLFitShift", "XmaxFitShift", "sigmaXmaxShift"},
+   {"RFitABS", "sigmaRFitABS", "LFitABS", "sigmaLFitABS", "XmaxFitABS", "sigmaXmaxABS"}},
+  {{"RAndringaFit", "sigmaRAndringa", "LAndringaFit", "sigmaLAndringa", "XmaxAndringaFit", "sigmaXmaxAndringa"},
+   {"RAndringaFitShift", "sigmaRAndringaShift", "LAndringaFitShift", "sigmaLAndringaShift", "XmaxAndringaFitShift", "sigmaXmaxAndringaShift"},
+   {"RAndringaFitABS", "sigmaRAndringaABS", "LAndringaFitABS", "sigmaLAndringaABS", "XmaxAndringaFitABS", "sigmaXmaxAndringaABS"}}
+};
+
+/// The six columns of a fit, in the order of writeFitRLXmax or (xmaxFirst) writeFitXmaxRL
+static void addFitColumns(vector<ColumnSpec>& columns, const char* const names[6], bool xmaxFirst) {
+  const int order[2][6] = {{0, 1, 2, 3, 4, 5}, {4, 5, 0, 1, 2, 3}};
+  for (int k = 0; k < 6; ++k) {
+    columns.push_back({names[order[xmaxFirst][k]], ColumnType::Float64});
+  }
+}
 
-                if ( distEM <= 100. ) {
-                  nEMDist100 += wEM;
-                }
+static void addFitValues(vector<double>& values, const ProfileFit& f, bool xmaxFirst) {
+  if (xmaxFirst) {
+    values.insert(values.end(), {f.Xmax, f.XmaxSigma, f.R, f.RSigma, f.L, f.LSigma});
+  } else {
+    values.insert(values.end(), {f.R, f.RSigma, f.L, f.LSigma, f.Xmax, f.XmaxSigma});
+  }
+}
 
-                if ( distEM <= 150. ) {
-                  nEMDist150 += wEM;
-                }
+static vector<ColumnSpec> rowColumns(const ReaderOptions& opt) {
+  vector<ColumnSpec> columns = {
+    {"ParticleID", ColumnType::Int32}, {"E(GeV)", ColumnType::Float32},
+    {"zenith", ColumnType::Float64}, {"azimuth", ColumnType::Float64}};
+  ShowerCounters(opt.binning).Columns(columns);
+  if (opt.readLong) {
+    for (const char* name : {"xmax", "nMuLong", "nEMxmax", "nEMLong", "Rcorsika", "Lcorsika"}) {
+      columns.push_back({name, ColumnType::Float64});
+    }
+    if (opt.allFits) {
+      for (int v = 0; v < NumFitVariants; ++v) {
+        addFitColumns(columns, kFitNames[0][v], false);
+      }
+      for (int v = 0; v < NumFitVariants; ++v) {
+        addFitColumns(columns, kFitNames[1][v], true);
+      }
+    } else {
+      addFitColumns(columns, kFitNames[0][ShiftFit], false);
+      addFitColumns(columns, kFitNames[1][PlainFit], false);
+    }
+  }
+  return columns;
+}
 
-                if ( distEM <= 200. ) {
-                  nEMDist200 += wEM;
-                }
+/// --------------------------------------------------------------------------------------------
+/// Writes the rows in input order, as text or with --columns to the column file. With --long
+/// the rows wait until kFitLanes showers are pending, the profiles of consecutive files are then
+/// fitted together in one batch.
+/// --------------------------------------------------------------------------------------------
+class RowWriter {
+ public:
+  RowWriter(const ReaderOptions& opt, ostream& out, ostream* spectraOut, ColumnWriter* columns)
+    : opt_(opt), out_(out), spectraOut_(spectraOut), columns_(columns) {}
+
+  void Add(FileOutput&& file) {
+    nProfiles_ += file.profiles.size();
+    pending_.push_back(std::move(file));
+    if (!opt_.readLong || nProfiles_ >= (size_t) kFitLanes) {
+      Flush();
+    }
+  }
 
-                if ( distEM <= 250. ) {
-                  nEMDist250 += wEM;
-                }
+  /// --manifest: all outputs of input have been added, its line is written behind their rows
+  void Complete(const std::string& input, bool ok) {
+    FileOutput marker;
+    marker.completes = input;
+    marker.completesOK = ok;
+    Add(std::move(marker));
+  }
 
-                if ( distEM <= 300. ) {
-                  nEMDist300 += wEM;
-                }
+  void Flush() {
+    vector<LongProfile> profiles;
+    vector<LongSummary> summaries;
+    for (FileOutput& file : pending_) {
+      for (size_t h = 0; h < file.profiles.size(); ++h) {
+        profiles.push_back(std::move(file.profiles[h]));
+        summaries.push_back(file.summaries[h]);
+      }
+    }
+    vector<LongFits> fits = fitLongProfiles(profiles, summaries, opt_.removeFinal20gcm2, opt_.allFits);
+
+    size_t p = 0;
+    for (const FileOutput& file : pending_) {
+      if (columns_) {
+        WriteColumns(file, fits, p);
+      } else {
+        WriteText(file, fits, p);
+      }
+      p += file.summaries.size();
+      if (spectraOut_) {
+        *spectraOut_ << file.spectra;
+      }
+      if (!file.completes.empty()) {
+        out_.flush();
+        opt_.manifest->Finish(file.completes, file.completesOK, out_.tellp());
+      }
+    }
+    pending_.clear();
+    nProfiles_ = 0;
+  }
 
-                if ( distEM <= 350. ) {
-                  nEMDist350 += wEM;
-                }
+ private:
+  /// Showers first..last-1 give the .long columns of row r: every shower of the file for a file row,
+  /// its own shower for a --per-event row
+  void RowShowers(const FileOutput& file, size_t r, size_t& first, size_t& last) const {
+    if (opt_.perEvent) {
+      last = min(file.rowShowers[r] + 1, file.summaries.size());
+      first = min(file.rowShowers[r], last);
+    } else {
+      first = 0;
+      last = file.summaries.size();
+    }
+  }
 
-                if ( distEM <= 400. ) {
-                  nEMDist400 += wEM;
-                }
+  void WriteText(const FileOutput& file, const vector<LongFits>& fits, size_t p) {
+    for (size_t r = 0; r < file.rows.size(); ++r) {
+      out_ << file.rows[r];
+      // xmax nMuLong nEMxmax nEMLong Rcorsika Lcorsika and the profile fits of every shower
+      // Particle numbers at xmax/ground reach 1e9, print them without the default 6 digit rounding
+      streamsize oldPrecision = out_.precision(10);
+      size_t first, last;
+      RowShowers(file, r, first, last);
+      for (size_t h = first; h < last; ++h) {
+        const LongSummary& s = file.summaries[h];
+        const LongFits& f = fits[p + h];
+        out_ << " " << s.xmax << " " << s.nMuLong << " " << s.nEMxmax << " " << s.nEMLong
+             << " " << s.Rcorsika << " " << s.Lcorsika;
+        if (opt_.allFits) {
+          for (int v = 0; v < NumFitVariants; ++v) {
+            writeFitRLXmax(out_, f.gh[v]);
+          }
+          for (int v = 0; v < NumFitVariants; ++v) {
+            writeFitXmaxRL(out_, f.andringa[v]);
+          }
+        } else {
+          writeFitRLXmax(out_, f.gh[ShiftFit]);
+          writeFitRLXmax(out_, f.andringa[PlainFit]);
+        }
+      }
+      out_.precision(oldPrecision);
+      out_ << endl;
+    }
+  }
 
-                if ( distEM <= 450. ) {
-                  nEMDist450 += wEM;
-                }
+  /// One row per file with the .long columns of its first shower (per shower with --per-event),
+  /// NaN if it has no profile
+  void WriteColumns(const FileOutput& file, const vector<LongFits>& fits, size_t p) {
+    if (!opt_.perEvent && file.zeniths.size() > 1) {
+      cerr << file.name << ": " << file.zeniths.size() << " showers, only the first one goes to the column file"
+           << " (--per-event writes all of them)" << endl;
+    }
+    for (size_t r = 0; r < file.values.size(); ++r) {
+      vector<double> values = file.values[r];
+      size_t first, last;
+      RowShowers(file, r, first, last);
+      if (opt_.readLong && first < last) {
+        const LongSummary& s = file.summaries[first];
+        const LongFits& f = fits[p + first];
+        values.insert(values.end(), {s.xmax, s.nMuLong, s.nEMxmax, s.nEMLong, s.Rcorsika, s.Lcorsika});
+        if (opt_.allFits) {
+          for (int v = 0; v < NumFitVariants; ++v) {
+            addFitValues(values, f.gh[v], false);
+          }
+          for (int v = 0; v < NumFitVariants; ++v) {
+            addFitValues(values, f.andringa[v], true);
+          }
+        } else {
+          addFitValues(values, f.gh[ShiftFit], false);
+          addFitValues(values, f.andringa[PlainFit], false);
+        }
+      }
+      values.resize(columns_->NumColumns(), NAN);
+      columns_->AddRow(values);
+    }
+  }
 
-                if ( distEM <= 500. ) {
-                  nEMDist500 += wEM;
-                }
+  const ReaderOptions& opt_;
+  ostream& out_;
+  ostream* spectraOut_;
+  ColumnWriter* columns_;
+  vector<FileOutput> pending_;
+  size_t nProfiles_ = 0;
+};
 
-                if ( distEM <= 550. ) {
-                  nEMDist550 += wEM;
-                }
+/// --------------------------------------------------------------------------------------------
+/// MAIN PART - READING.....
+/// --------------------------------------------------------------------------------------------
 
-                if ( distEM <= 600. ) {
-                  nEMDist600 += wEM;
-                }
 
-                if ( distEM <= 650. ) {
-                  nEMDist650 += wEM;
-                }
+int main (int argc, char *argv[]) {
 
-                if ( distEM <= 700. ) {
-                  nEMDist700 += wEM;
-                }
+  if (argc < 3) {
+    cerr << "--------------------------------------------------------------------------------\n";
+    cerr << "This program counts the muons and e+/- in the air shower at different distances:\n";
+    cerr << "You must give the input filename and type of CORSIKA file (thinned or standard)\n";
+    cerr << "Usage is ./corsikaReader <InputFile1> [InputFile2 InputFile3 ...] [OPTIONS] --FILE_FLAG\n";
+    cerr << "--FILE_FLAG can be: --thinned or --standard\n";
+    cerr << "Gzip, bzip2 and zstd compressed DAT files are read directly (detected by their first bytes)\n";
+    cerr << "An input file DATnnnnnn.tar.gz (.tgz, .tar, .tar.bz2, .tar.zst) is read without extracting it, every\n";
+    cerr << "DAT file in it gives a row and --long takes the profiles from the .long files in the same archive\n";
+    cerr << "OPTIONS can be:\n";
+    cerr << "  --no-mmap      read the files with buffered reads instead of memory mapping them\n";
+    cerr << "  --async-io     read ahead with large reads on I/O threads while parsing, hides the latency of\n";
+    cerr << "                 NFS/Lustre (records are parsed on one thread per file, combine with --jobs)\n";
+    cerr << "  --read-size MB    bytes per read of --async-io in MB, rounded to whole records (default 4)\n";
+    cerr << "  --queue-depth N   reads of --async-io in flight per file (default 4)\n";
+    cerr << "  --threads N    split each file into N record ranges parsed in parallel (default 1), with\n";
+    cerr << "                 --per-event the showers of a file are parsed in parallel instead\n";
+    cerr << "  --per-event    one row per shower (EVTH to EVTE) instead of one per DAT file, for files holding\n";
+    cerr << "                 several showers; the .long columns of a row are those of its own shower\n";
+    cerr << "  --event N      only the row of shower N (counted from 1) of every file, implies --per-event; with a\n";
+    cerr << "                 valid <InputFile>.index only the records of that shower are read\n";
+    cerr << "  --write-index  write <InputFile>.index next to every DAT file: the record and sub-block of its RUNH, EVTH,\n";
+    cerr << "                 LONG, EVTE and RUNE (column file, see recordIndex.h); --event and --per-event --threads\n";
+    cerr << "                 use it to find the showers without reading the file first\n";
+    cerr << "  --index-only   only write the indexes, from the header sub-blocks, no rows\n";
+    cerr << "  --jobs N       parse N files at the same time, rows are still written in input order (default 1)\n";
+    cerr << "  --verify       only check the files: record length markers of every record and the RUNH, EVTH, LONG,\n";
+    cerr << "                 EVTE and RUNE sub-blocks, one tab separated line per DAT file (status ok, corrupt,\n";
+    cerr << "                 truncated, incomplete or unreadable) to stdout or --output, no particles are parsed\n";
+    cerr << "  --resync       do not end a file at a broken record: skip to the next record whose record length markers\n";
+    cerr << "                 are both right, report the lost byte ranges and count the rest of the file (records are\n";
+    cerr << "                 read one by one then, a record with a wrong trailing marker is not counted)\n";
+    cerr << "  --output F     write the text rows to F instead of stdout\n";
+    cerr << "  --manifest M   keep the append-only manifest M of the batch (input, size, mtime, output offset, status)\n";
+    cerr << "                 next to --output; run the same command again after an interruption and it skips the\n";
+    cerr << "                 finished inputs and continues a file from its last checkpoint (see batchManifest.h)\n";
+    cerr << "  --checkpoint S    seconds between two checkpoints of a file read record by record (default 300)\n";
+    cerr << "  --file-list F  also read the input files from F, one file name per line\n";
+    cerr << "  --radial-bins N   number of cumulative radial columns per species (default 20)\n";
+    cerr << "  --radial-width W  width of the radial bins in m (default 50)\n";
+    cerr << "  --spectra F    write 1000-bin lateral (mu, e+/-) and energy (mu) spectra of every file to F\n";
+    cerr << "  --columns F    write the rows to the binary column file F instead of text to stdout, one row per\n";
+    cerr << "                 DAT file (or shower) with typed, named columns (format in columnFile.h, corsikaColumns.py reads it)\n";
+    cerr << "  --meta K=V     metadata of the column file, e.g. --meta model=EPOS_LHC-R --meta primary=iron\n";
+    cerr << "                 (repeatable, the simulation type and reader settings are added automatically)\n";
+    cerr << "  --export D     also write the ground particles of every DAT file to D/<DAT name>.particles.ccol, one row\n";
+    cerr << "                 per particle: event id px py pz x y t weight ekin r (column file, see particleExport.h)\n";
+    cerr << "  --export-species S  only these particles, comma separated CORSIKA ids or gamma, em, mu, pi, n, p\n";
+    cerr << "  --export-emin E, --export-emax E  kinetic energy range of the exported particles in GeV\n";
+    cerr << "  --export-rmin R, --export-rmax R  range of the distance to the shower axis in m\n";
+    cerr << "  --long         also read <InputFile>.long and append xmax, nMuLong, nEMxmax, nEMLong, Rcorsika, Lcorsika\n";
+    cerr << "                 and the shifted Gaisser-Hillas and the Andringa fit of the e+/- profile\n";
+    cerr << "  --remove-final-20gcm2  leave the last 20 g/cm2 of the profile out of the fits\n";
+    cerr << "  --all-fits     plain, shifted and absolute value variants of both fits\n";
+    cerr << "  --ground-depth D  vertical depth of the observation level in g/cm2 for --long (default 870)\n";
+    cerr << "  --kernel K     particle and profile fit kernel: auto, scalar, avx2 or avx512 (default auto, best one for this CPU)\n";
+    cerr << "--------------------------------------------------------------------------------\n";
 
-                if ( distEM <= 750. ) {
-                  nEMDist750 += wEM;
-                }
+    return 0;
+  }
 
-                if ( distEM <= 800. ) {
-                  nEMDist800 += wEM;
-                }
+  SimType mode;
+  bool modeGiven = false;
+  ReaderOptions opt;
+  int nJobs = 1;
+  int nRadialBins = 20;
+  double radialWidth = 50.;
+  vector<string> inputFiles;
+  std::string spectraFile;
+  std::string columnsFile;
+  std::string outputFile;
+  std::string manifestFile;
+  bool verify = false;
+  vector<pair<string, string> > metadata;
+
+  for (int k = 1; k < argc; ++k) {
+    std::string arg = argv[k];
+
+    if (arg == "--thinned") {
+      mode = SimType::Thinned;   // thinned corsika file
+      modeGiven = true;
+    } else if (arg == "--standard") {
+      mode = SimType::Standard;   // standard corsika file
+      modeGiven = true;
+    } else if (arg == "--no-mmap") {
+      opt.io.useMmap = false;
+    } else if (arg == "--async-io") {
+      opt.io.async = true;
+    } else if (arg == "--read-size" && k + 1 < argc) {
+      opt.io.readBytes = (size_t) (max(0.01, atof(argv[++k])) * (1 << 20));
+    } else if (arg == "--queue-depth" && k + 1 < argc) {
+      opt.io.queueDepth = max(1, atoi(argv[++k]));
+    } else if (arg == "--threads" && k + 1 < argc) {
+      opt.nThreads = max(1, atoi(argv[++k]));
+    } else if (arg == "--per-event") {
+      opt.perEvent = true;
+    } else if (arg == "--event" && k + 1 < argc) {
+      opt.perEvent = true;
+      opt.onlyEvent = max(1, atoi(argv[++k]));
+    } else if (arg == "--write-index") {
+      opt.writeIndex = true;
+    } else if (arg == "--index-only") {
+      opt.writeIndex = true;
+      opt.indexOnly = true;
+    } else if (arg == "--jobs" && k + 1 < argc) {
+      nJobs = max(1, atoi(argv[++k]));
+    } else if (arg == "--output" && k + 1 < argc) {
+      outputFile = argv[++k];
+    } else if (arg == "--manifest" && k + 1 < argc) {
+      manifestFile = argv[++k];
+    } else if (arg == "--verify") {
+      verify = true;
+    } else if (arg == "--resync") {
+      opt.resync = true;
+    } else if (arg == "--checkpoint" && k + 1 < argc) {
+      opt.checkpointSeconds = max(0., atof(argv[++k]));
+    } else if (arg == "--file-list" && k + 1 < argc) {
+      if (!readFileList(argv[++k], inputFiles)) {
+        cerr << "Cannot read file list " << argv[k] << endl;
+        return 0;
+      }
+    } else if (arg == "--spectra" && k + 1 < argc) {
+      spectraFile = argv[++k];
+    } else if (arg == "--columns" && k + 1 < argc) {
+      columnsFile = argv[++k];
+    } else if (arg == "--meta" && k + 1 < argc) {
+      string entry = argv[++k];
+      size_t equal = entry.find('=');
+      if (equal == string::npos || equal == 0) {
+        cerr << "--meta expects KEY=VALUE, not " << entry << endl;
+        return 0;
+      }
+      metadata.push_back(make_pair(entry.substr(0, equal), entry.substr(equal + 1)));
+    } else if (arg == "--radial-bins" && k + 1 < argc) {
+      nRadialBins = max(1, atoi(argv[++k]));
+    } else if (arg == "--radial-width" && k + 1 < argc) {
+      radialWidth = atof(argv[++k]);
+      if ( !(radialWidth > 0.) ) {
+        cerr << "The radial bin width must be positive" << endl;
+        return 0;
+      }
+    } else if (arg == "--export" && k + 1 < argc) {
+      opt.exportDir = argv[++k];
+    } else if (arg == "--export-species" && k + 1 < argc) {
+      if (!parseSpeciesList(argv[++k], opt.exportFilter.species)) {
+        cerr << "Unknown particle in --export-species " << argv[k] << endl;
+        return 0;
+      }
+    } else if (arg == "--export-emin" && k + 1 < argc) {
+      opt.exportFilter.eMin = atof(argv[++k]);
+    } else if (arg == "--export-emax" && k + 1 < argc) {
+      opt.exportFilter.eMax = atof(argv[++k]);
+    } else if (arg == "--export-rmin" && k + 1 < argc) {
+      opt.exportFilter.rMin = atof(argv[++k]);
+    } else if (arg == "--export-rmax" && k + 1 < argc) {
+      opt.exportFilter.rMax = atof(argv[++k]);
+    } else if (arg == "--long") {
+      opt.readLong = true;
+    } else if (arg == "--remove-final-20gcm2") {
+      opt.removeFinal20gcm2 = true;
+    } else if (arg == "--all-fits") {
+      opt.allFits = true;
+    } else if (arg == "--ground-depth" && k + 1 < argc) {
+      opt.groundDepth = atof(argv[++k]);
+    } else if (arg == "--kernel" && k + 1 < argc) {
+      if (!selectParticleKernel(argv[++k]) || !selectFitKernel(argv[k])) {
+        cerr << "Kernel " << argv[k] << " is not available on this machine" << endl;
+        return 0;
+      }
+    } else if (arg.compare(0, 2, "--") == 0) {
+      modeGiven = false;
+      break;
+    } else {
+      inputFiles.push_back(arg);
+    }
+  }
 
-                if ( distEM <= 850. ) {
-                  nEMDist850 += wEM;
-                }
+  if (!modeGiven) {
+    cerr << "-----------------------------------------------------------------------------\n";
+    cerr << "Invalid file flag given!\n";
+    cerr << "Usage is ./corsikaReader <InputFile1> [InputFile2 InputFile3 ...] [OPTIONS] --FILE_FLAG\n";
+    cerr << "--FILE_FLAG must be either: --thinned or --standard\n";
+    cerr << "-----------------------------------------------------------------------------\n";
+    return 0;
+  }
 
-                if ( distEM <= 900. ) {
-                  nEMDist900 += wEM;
-                }
+  // If mode is Thinned, then use "thinned corsika" record size, else use "standard corsika" record size
+  opt.isThin = (mode == SimType::Thinned) ? true : false;
+  opt.nrecstd = opt.isThin ? ThinnedLayout::recordBytes : StandardLayout::recordBytes;
 
-                if ( distEM <= 950. ) {
-                  nEMDist950 += wEM;
-                }
+  opt.binning = RadialBins(nRadialBins, radialWidth);
 
-                if ( distEM <= 1000. ) {
-                  nEMDist1000 += wEM;
-                }
+  // The .long files are not parsed on their own, --long reads them together with their DAT file
+  vector<string> datFiles;
+  for (size_t k = 0; k < inputFiles.size(); ++k) {
+    if (!(inputFiles[k].find(".long") != std::string::npos)) {
+      datFiles.push_back(inputFiles[k]);
+    }
+  }
 
+  /// --------------------------------------------------------------------------------------------
+  /// CHECKING ONLY (--verify)
+  /// --------------------------------------------------------------------------------------------
+  if (verify) {
+    ofstream reportFile;
+    if (!outputFile.empty()) {
+      reportFile.open(outputFile);
+      if (!reportFile) {
+        cerr << "Cannot write the report to " << outputFile << endl;
+        return 0;
+      }
+    }
+    ostream& report = outputFile.empty() ? cout : reportFile;
+    report << kVerifyHeader << "\n";
 
-              } else {
-                continue;
-              }
-            }
-          }
-        }
-        /// end of the record
-        if ( !getBinary( sdata[21 * nsblstd + 1], isThin ) ) {
-          cerr << "This file is corrupted, this is not a record length - end of block!" << endl;
-          BROKENflag = true;
-          break;
+    vector<size_t> sizes(datFiles.size());
+    for (size_t k = 0; k < datFiles.size(); ++k) {
+      sizes[k] = fileSize(datFiles[k]);
+    }
+    vector<vector<string> > lines(datFiles.size());
+    runBatch(sizes, nJobs,
+      [&](size_t k) {
+        lines[k] = verifyInput(datFiles[k], opt);
+      },
+      [&](size_t k) {
+        for (const string& line : lines[k]) {
+          report << line << "\n";
         }
+        lines[k].clear();
+        report.flush();
+        return true;
+      });
+    return 0;
+  }
+
+  // The manifest records offsets into the text rows, a spectra or column file is not continued
+  BatchManifest manifest;
+  if (!manifestFile.empty()) {
+    if (outputFile.empty() || !spectraFile.empty() || !columnsFile.empty()) {
+      cerr << "--manifest needs the rows in a text file (--output) and works without --spectra and --columns" << endl;
+      return 0;
+    }
+    string error;
+    if (!manifest.Open(manifestFile, outputFile, error)) {
+      cerr << error << endl;
+      return 0;
+    }
+    opt.manifest = &manifest;
+  }
+
+  ofstream outputStream;
+  if (!outputFile.empty()) {
+    uint64_t offset = manifest.ResumeOffset();
+    if (offset > 0) {
+      // Rows behind the last line of the manifest belong to unfinished inputs and are written again
+      if (fileSize(outputFile) < offset || truncate(outputFile.c_str(), offset) != 0) {
+        cerr << "Cannot continue the batch, " << outputFile << " is shorter than recorded in " << manifestFile << endl;
+        return 0;
+      }
+      outputStream.open(outputFile, ios::in | ios::out);
+      outputStream.seekp(0, ios::end);
+    } else {
+      outputStream.open(outputFile, ios::out | ios::trunc);
+    }
+    if (!outputStream) {
+      cerr << "Cannot write the rows to " << outputFile << endl;
+      return 0;
+    }
+  }
+  ostream& rowOut = outputFile.empty() ? cout : outputStream;
+
+  // A restarted batch goes on after its finished inputs
+  if (opt.manifest) {
+    vector<string> remaining;
+    for (const string& input : datFiles) {
+      const ManifestEntry* entry = manifest.Find(input);
+      if (!entry || entry->status == "checkpoint") {
+        remaining.push_back(input);
       }
+    }
+    if (remaining.size() < datFiles.size()) {
+      cerr << "Continuing the batch of " << manifestFile << " with " << remaining.size() << " of "
+           << datFiles.size() << " inputs" << endl;
+    }
+    datFiles.swap(remaining);
+  }
+
+  ofstream spectraStream;
+  if (!spectraFile.empty()) {
+    spectraStream.open(spectraFile);
+    if (!spectraStream) {
+      cerr << "Cannot write spectra to " << spectraFile << endl;
+      return 0;
+    }
+  }
+  ostream* spectraOut = spectraFile.empty() ? nullptr : &spectraStream;
+
+  if (!opt.exportDir.empty() && mkdir(opt.exportDir.c_str(), 0755) != 0 && errno != EEXIST) {
+    cerr << "Cannot create the export directory " << opt.exportDir << endl;
+    return 0;
+  }
+
+  std::unique_ptr<ColumnWriter> columns;
+  if (!columnsFile.empty()) {
+    ostringstream width, depth;
+    width << radialWidth;
+    depth << opt.groundDepth;
+    metadata.push_back(make_pair("simulation", opt.isThin ? "thinned" : "standard"));
+    metadata.push_back(make_pair("radial_bins", to_string(nRadialBins)));
+    metadata.push_back(make_pair("radial_width_m", width.str()));
+    if (opt.perEvent) {
+      metadata.push_back(make_pair("rows", "shower"));
+    }
+    if (opt.readLong) {
+      metadata.push_back(make_pair("ground_depth_gcm2", depth.str()));
+      metadata.push_back(make_pair("remove_final_20gcm2", opt.removeFinal20gcm2 ? "yes" : "no"));
+      metadata.push_back(make_pair("fits", opt.allFits ? "all" : "default"));
+    }
+    columns.reset(new ColumnWriter(columnsFile, rowColumns(opt), metadata));
+    if ( !columns->Good() ) {
+      cerr << "Cannot write columns to " << columnsFile << endl;
+      return 0;
+    }
+  }
 
-      // Round the number of particles to nearest integer, since weights can be fractional in thinned showers
-      nMuons = round(nMuons);
-      nMuons1 = round(nMuons1);
-      nMuons500 = round(nMuons500);
-      nMuons1000 = round(nMuons1000);
-
-      thinWeight1 = round(thinWeight1);
-      thinWeight500 = round(thinWeight500);
-
-      nMuDist50 = round(nMuDist50);
-      nMuDist100 = round(nMuDist100);
-      nMuDist150 = round(nMuDist150);
-      nMuDist200 = round(nMuDist200);
-      nMuDist250 = round(nMuDist250);
-      nMuDist300 = round(nMuDist300);
-      nMuDist350 = round(nMuDist350);
-      nMuDist400 = round(nMuDist400);
-      nMuDist450 = round(nMuDist450);
-      nMuDist500 = round(nMuDist500);
-      nMuDist550 = round(nMuDist550);
-      nMuDist600 = round(nMuDist600);
-      nMuDist650 = round(nMuDist650);
-      nMuDist700 = round(nMuDist700);
-      nMuDist750 = round(nMuDist750);
-      nMuDist800 = round(nMuDist800);
-      nMuDist850 = round(nMuDist850);
-      nMuDist900 = round(nMuDist900);
-      nMuDist950 = round(nMuDist950);
-      nMuDist1000 = round(nMuDist1000);
-
-      nEM = round(nEM);
-
-      nEMDist50 = round(nEMDist50);
-      nEMDist100 = round(nEMDist100);
-      nEMDist150 = round(nEMDist150);
-      nEMDist200 = round(nEMDist200);
-      nEMDist250 = round(nEMDist250);
-      nEMDist300 = round(nEMDist300);
-      nEMDist350 = round(nEMDist350);
-      nEMDist400 = round(nEMDist400);
-      nEMDist450 = round(nEMDist450);
-      nEMDist500 = round(nEMDist500);
-      nEMDist550 = round(nEMDist550);
-      nEMDist600 = round(nEMDist600);
-      nEMDist650 = round(nEMDist650);
-      nEMDist700 = round(nEMDist700);
-      nEMDist750 = round(nEMDist750);
-      nEMDist800 = round(nEMDist800);
-      nEMDist850 = round(nEMDist850);
-      nEMDist900 = round(nEMDist900);
-      nEMDist950 = round(nEMDist950);
-      nEMDist1000 = round(nEMDist1000);
-
-      cout << nMuons << " " << nMuons1 << " " << nMuons500 << " " << nMuons1000 << " "
-           << muonThin1 << " " << thinWeight1 << " " << muonThin500 << " " << thinWeight500 << " "
-           << nMuDist50 << " " << nMuDist100 << " " << nMuDist150 << " " << nMuDist200 << " "
-           << nMuDist250 << " " << nMuDist300 << " " << nMuDist350 << " " << nMuDist400 << " "
-           << nMuDist450 << " " << nMuDist500 << " " << nMuDist550 << " " << nMuDist600 << " "
-           << nMuDist650 << " " << nMuDist700 << " " << nMuDist750 << " " << nMuDist800 << " "
-           << nMuDist850 << " " << nMuDist900 << " " << nMuDist950 << " " << nMuDist1000 << " "
-           << nEM << " " << nEMDist50 << " " << nEMDist100 << " " << nEMDist150 << " " << nEMDist200 << " "
-           << nEMDist250 << " " << nEMDist300 << " " << nEMDist350 << " " << nEMDist400 << " "
-           << nEMDist450 << " " << nEMDist500 << " " << nEMDist550 << " " << nEMDist600 << " "
-           << nEMDist650 << " " << nEMDist700 << " " << nEMDist750 << " " << nEMDist800 << " "
-           << nEMDist850 << " " << nEMDist900 << " " << nEMDist950 << " " << nEMDist1000 << endl;
-
-      if ( BROKENflag || !(EVTEcnt == nrShow) ) {
-        cerr << "Files is broken: not enough EVTE or garbage word is wrong " << file_ << endl;
-        break;
+  /// --------------------------------------------------------------------------------------------
+  /// THE MAIN LOOP
+  /// --------------------------------------------------------------------------------------------
+  RowWriter writer(opt, rowOut, spectraOut, columns.get());
+  if (nJobs > 1) {
+    /// Batch mode: files are parsed in parallel, rows are kept until all rows before them are written
+    vector<size_t> sizes(datFiles.size());
+    for (size_t k = 0; k < datFiles.size(); ++k) {
+      sizes[k] = fileSize(datFiles[k]);
+    }
+    vector<vector<FileOutput> > outputs(datFiles.size());
+    vector<char> fileOK(datFiles.size(), 1);
+
+    runBatch(sizes, nJobs,
+      [&](size_t k) {
+        fileOK[k] = parseInput(datFiles[k], opt, spectraOut != nullptr, outputs[k]);
+      },
+      [&](size_t k) {
+        for (FileOutput& output : outputs[k]) {
+          writer.Add(std::move(output));
+        }
+        outputs[k].clear();
+        if (opt.manifest) {
+          writer.Complete(datFiles[k], fileOK[k]);
+        }
+        // A broken file is reported, the files after it are still parsed
+        if ( !fileOK[k] ) {
+          cerr << "Files is broken: not enough EVTE or garbage word is wrong " << datFiles[k] << endl;
+        }
+        return true;
+      });
+  } else {
+    /// This reads all input files one by one
+    for (size_t k = 0; k < datFiles.size(); ++k) {
+      vector<FileOutput> outputs;
+      bool fileOK = parseInput(datFiles[k], opt, spectraOut != nullptr, outputs);
+      for (FileOutput& output : outputs) {
+        writer.Add(std::move(output));
+      }
+      if (opt.manifest) {
+        writer.Complete(datFiles[k], fileOK);
+      }
+      if ( !fileOK ) {
+        cerr << "Files is broken: not enough EVTE or garbage word is wrong " << datFiles[k] << endl;
       }
-      is.close();
     }
   }
+  writer.Flush();
+  if (columns && !columns->Close()) {
+    cerr << "Error writing the column file " << columnsFile << endl;
+  }
   return 0;
 }
-
-
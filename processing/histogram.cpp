@@ -0,0 +1,88 @@
+#include "histogram.h"
+
+using namespace std;
+
+histogram::histogram(double a, double b, int c, Binning type) {
+  binning = type;
+  binStart  = a;
+  binEnd    = b;
+  binNumber = c;
+  binContent = vector<double> (binNumber, 0.);
+
+  if (binning == LogUniform) {
+    logStart = log(binStart);
+    width = (log(binEnd) - logStart) / (double)binNumber ;
+  } else {
+    width = (binEnd - binStart) / (double)binNumber ;
+  }
+  invWidth = 1. / width;
+
+  for (int b = 0; b <= binNumber; b++) {
+    if (binning == LogUniform) {
+      edges.push_back( exp(logStart + width * b) );
+    } else {
+      edges.push_back( binStart + width * b );
+    }
+  }
+  // The outer edges are exactly the requested range
+  edges.front() = binStart;
+  edges.back() = binEnd;
+
+  for (int b = 0; b < binNumber; b++) {
+    edgeLeft.push_back( edges[b] );
+    edgeRight.push_back( edges[b + 1] );
+    binCenter.push_back( (edgeRight[b] + edgeLeft[b]) / 2. );
+  }
+}
+
+histogram::histogram(const vector<double>& binEdges) {
+  binning = Variable;
+  edges = binEdges;
+  sort(edges.begin(), edges.end());
+  binNumber = edges.size() > 1 ? edges.size() - 1 : 0;
+  if (binNumber > 0) {
+    binStart = edges.front();
+    binEnd = edges.back();
+  }
+  binContent = vector<double> (binNumber, 0.);
+
+  for (int b = 0; b < binNumber; b++) {
+    edgeLeft.push_back( edges[b] );
+    edgeRight.push_back( edges[b + 1] );
+    binCenter.push_back( (edgeRight[b] + edgeLeft[b]) / 2. );
+  }
+}
+
+void histogram::SetBinContent (int bin, double value) {
+  binContent.at(bin) = value;
+}
+
+double histogram::GetBinContent (int bin) const {
+  return binContent.at(bin);
+}
+
+double histogram::GetBinCenter (int bin) const {
+  return binCenter.at(bin);
+}
+
+void histogram::Add (const histogram& other) {
+  for (int f = 0; f < binNumber && f < other.binNumber; f++) {
+    binContent[f] += other.binContent[f];
+  }
+}
+
+void histogram::Reset () {
+  for (int f = 0; f < binNumber; f++) {
+    binContent[f] = 0.;
+  }
+}
+
+void histogram::Dump () const {
+  Dump(cout);
+}
+
+void histogram::Dump (ostream& out) const {
+  for (int f = 0; f < binNumber; f++) {
+    out << f << " " << edgeLeft[f] << " " << edgeRight[f] << " "  << binContent[f] << " " << binCenter[f] << endl;
+  }
+}
@@ -0,0 +1,92 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+/// --------------------------------------------------------------------------------------------
+/// a small set of function to make histograms while reading
+/// --------------------------------------------------------------------------------------------
+/// Bins are left-inclusive, edgeLeft <= x < edgeRight, values outside [binStart, binEnd) are dropped.
+/// Fill finds the bin in constant time for uniform and log-uniform binning and by binary search
+/// over the edges for variable binning.
+class histogram {
+public:
+  enum Binning {Uniform, LogUniform, Variable};
+
+private:
+  Binning binning = Uniform;
+  double binStart  = 0;
+  double binEnd    = 0;
+  int binNumber = 0;
+  double width  = 0;     // in log(x) for LogUniform
+  double invWidth = 0;
+  double logStart = 0;
+  std::vector<double> edges;  // binNumber + 1 edges, edges[b] = edgeLeft[b]
+
+  int FindBin(double x) const;
+
+public:
+  histogram() {};
+  histogram(double a, double b, int c, Binning type = Uniform);  // LogUniform needs 0 < a < b
+  histogram(const std::vector<double>& binEdges);
+  ~histogram() {};
+
+  std::vector<double> binContent;
+  std::vector<double> binCenter;
+  std::vector<double> edgeLeft;
+  std::vector<double> edgeRight;
+  void   SetBinContent (int, double);
+  double GetBinContent (int) const;
+  double GetBinCenter (int) const;
+  int    GetNbins () const { return binNumber; };
+  void   Fill(double);
+  void   Fill(double, double);
+  void   Add(const histogram&);
+  void   Reset();
+  void   Dump() const;
+  void   Dump(std::ostream&) const;
+};
+
+inline int histogram::FindBin(double x) const {
+  if ( !(binStart <= x && x < binEnd) ) {
+    return -1;
+  }
+  int bin;
+  if (binning == Uniform) {
+    bin = (int) ((x - binStart) * invWidth);
+  } else if (binning == LogUniform) {
+    bin = (int) ((log(x) - logStart) * invWidth);
+  } else {
+    // first edge above x, the bin is the one to its left
+    bin = (int) (std::upper_bound(edges.begin(), edges.end(), x) - edges.begin()) - 1;
+  }
+  // The multiplication can round across an edge, the stored edges decide
+  if (bin >= binNumber) {
+    bin = binNumber - 1;
+  }
+  if (x < edges[bin]) {
+    bin -= 1;
+  } else if (x >= edges[bin + 1]) {
+    bin += 1;
+  }
+  return bin;
+}
+
+inline void histogram::Fill(double x) {
+  int bin = FindBin(x);
+  if (bin >= 0) {
+    binContent[bin] += 1;
+  }
+}
+
+inline void histogram::Fill(double x, double w) {
+  int bin = FindBin(x);
+  if (bin >= 0) {
+    binContent[bin] += w;
+  }
+}
+
+#endif
@@ -0,0 +1,227 @@
+#include "longProfile.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <math.h>
+using namespace std;
+
+static bool hasWord(const vector<string>& cols, const char* word) {
+  return find(cols.begin(), cols.end(), word) != cols.end();
+}
+
+bool readLongFile(const string& fileName, vector<LongProfile>& profiles) {
+  profiles.clear();
+  ifstream in(fileName);
+  if (!in) {
+    return false;
+  }
+  return readLongProfiles(in, profiles);
+}
+
+bool readLongProfiles(istream& in, vector<LongProfile>& profiles) {
+  profiles.clear();
+  string line;
+  vector<string> cols;
+  bool inDeposit = false;
+  int skipLines = 0;
+
+  while (getline(in, line)) {
+    istringstream words(line);
+    cols.clear();
+    string word;
+    while (words >> word) {
+      cols.push_back(word);
+    }
+
+    // "LONGITUDINAL DISTRIBUTION IN ... FOR SHOWER n" starts a shower, the fit section has these words too
+    if (cols.size() > 2 && cols[0] == "LONGITUDINAL" && cols[1] == "DISTRIBUTION") {
+      profiles.push_back(LongProfile());
+      inDeposit = false;
+      // Column header and first depth row, the latter is not used by the python parser either
+      skipLines = 2;
+      continue;
+    }
+    if (profiles.empty()) {
+      continue;
+    }
+    if (skipLines > 0) {
+      skipLines -= 1;
+      continue;
+    }
+
+    LongProfile& profile = profiles.back();
+    if (hasWord(cols, "ENERGY") && hasWord(cols, "DEPOSIT")) {
+      inDeposit = true;
+    }
+
+    if (hasWord(cols, "PARAMETERS") && cols.size() >= 6) {
+      profile.hasParameters = true;
+      profile.x0 = atof(cols[3].c_str());
+      profile.xmax = atof(cols[4].c_str());
+      profile.lambda = atof(cols[5].c_str());   // drop 1st + 2nd order corrections
+    }
+
+    if (cols.size() != 10 || hasWord(cols, "FIT") || inDeposit) {
+      continue;
+    }
+
+    profile.depth.push_back(atof(cols[0].c_str()));
+    profile.positrons.push_back(atof(cols[2].c_str()));
+    profile.electrons.push_back(atof(cols[3].c_str()));
+    profile.muPlus.push_back(atof(cols[4].c_str()));
+    profile.muMinus.push_back(atof(cols[5].c_str()));
+    profile.charged.push_back(atof(cols[7].c_str()));
+  }
+
+  return !profiles.empty();
+}
+
+LongSummary summarizeProfile(const LongProfile& profile, double zenith, double groundDepth) {
+  LongSummary s;
+  size_t n = profile.depth.size();
+  if (n == 0) {
+    return s;
+  }
+
+  // First depth of the EM maximum
+  size_t ixmax = 0;
+  for (size_t i = 1; i < n; ++i) {
+    if (profile.positrons[i] + profile.electrons[i] > profile.positrons[ixmax] + profile.electrons[ixmax]) {
+      ixmax = i;
+    }
+  }
+
+  s.xmax = profile.xmax;
+  if (profile.hasParameters) {
+    double x0Prime = profile.x0 - profile.xmax;
+    s.Rcorsika = sqrt(profile.lambda / fabs(x0Prime));   // shape parameter
+    s.Lcorsika = sqrt(fabs(x0Prime * profile.lambda));   // characteristic width
+  }
+  if (s.xmax > 1700) {  // sometimes corsika fits of the profile fail
+    s.xmax = profile.depth[ixmax];
+    s.Rcorsika = -1;
+    s.Lcorsika = -1;
+  }
+
+  // First depth closest to ground
+  double ground = groundDepth / cos(zenith);
+  size_t iground = 0;
+  for (size_t i = 1; i < n; ++i) {
+    if (fabs(profile.depth[i] - ground) < fabs(profile.depth[iground] - ground)) {
+      iground = i;
+    }
+  }
+
+  // nearbyint rounds half to even like python's round
+  s.nMuLong = nearbyint(profile.muPlus[iground] + profile.muMinus[iground]);
+  s.nEMxmax = profile.positrons[ixmax] + profile.electrons[ixmax];
+  s.nEMLong = nearbyint(profile.positrons[iground] + profile.electrons[iground]);
+  return s;
+}
+
+/// Depths and start values of one profile, see fitLongProfiles
+struct FitInput {
+  vector<double> depths;   // first nFit depths of the profile
+  ProfileFitJob gh;        // e+ + e-, 0 where the depth is left out
+  ProfileFitJob andringa;  // e+ + e- normalized to Nmax
+};
+
+static bool prepareFit(const LongProfile& profile, const LongSummary& summary, bool removeFinal20gcm2, FitInput& input) {
+  size_t n = profile.depth.size();
+  if (n < 2) {
+    return false;
+  }
+
+  // Nmax and its depth from the full profile
+  size_t ixmax = 0;
+  for (size_t i = 1; i < n; ++i) {
+    if (profile.positrons[i] + profile.electrons[i] > profile.positrons[ixmax] + profile.electrons[ixmax]) {
+      ixmax = i;
+    }
+  }
+  const double Nmax = profile.positrons[ixmax] + profile.electrons[ixmax];
+
+  // Remove final 20g/cm2 from fit because they are not physical,
+  // some part of the shower front reaches ground which causes a dip in particle numbers
+  size_t nFit = n;
+  if (removeFinal20gcm2) {
+    size_t numPointsToRemove = (size_t) (20.0 / (profile.depth[1] - profile.depth[0]));
+    nFit = (numPointsToRemove < n) ? n - numPointsToRemove : 0;
+  }
+
+  // Prevent errors if xmax is near ground level (i.e. ixmax is past the fitted depths)
+  const double XmaxGuess = (ixmax >= nFit) ? summary.xmax : profile.depth[ixmax];
+  const double X0Guess = 0;
+  const double lambGuess = 80.0;
+  const double RGuess = sqrt(lambGuess / fabs(X0Guess - XmaxGuess));
+  const double LGuess = sqrt(fabs(X0Guess - XmaxGuess) * lambGuess);
+
+  // Depths with no e+/- stay in the grid with 0 particles, the fit leaves them out
+  bool anyParticles = false;
+  input.depths.assign(profile.depth.begin(), profile.depth.begin() + nFit);
+  input.gh.particles.resize(nFit);
+  input.andringa.particles.resize(nFit);
+  for (size_t i = 0; i < nFit; ++i) {
+    double em = profile.positrons[i] + profile.electrons[i];
+    input.gh.particles[i] = em;
+    input.andringa.particles[i] = (em != 0) ? em / Nmax : 0.;
+    anyParticles |= (em != 0);
+  }
+  input.gh.start = {Nmax, XmaxGuess, X0Guess, lambGuess};
+  input.andringa.start = {XmaxGuess, RGuess, LGuess};
+  return anyParticles;
+}
+
+vector<LongFits> fitLongProfiles(const vector<LongProfile>& profiles, const vector<LongSummary>& summaries,
+                                 bool removeFinal20gcm2, bool allVariants) {
+  LongFits failed;
+  const double inf = numeric_limits<double>::infinity();
+  const ProfileFit failedFit = {inf, inf, inf, inf, inf, inf};
+  fill(failed.gh, failed.gh + NumFitVariants, failedFit);
+  fill(failed.andringa, failed.andringa + NumFitVariants, failedFit);
+  vector<LongFits> fits(profiles.size(), failed);
+
+  // Profiles of showers with the same depth binning share the grid, normally all of a production
+  vector<FitInput> inputs(profiles.size());
+  map<vector<double>, vector<size_t> > grids;
+  for (size_t k = 0; k < profiles.size(); ++k) {
+    if (prepareFit(profiles[k], summaries[k], removeFinal20gcm2, inputs[k])) {
+      grids[inputs[k].depths].push_back(k);
+    }
+  }
+
+  for (const auto& grid : grids) {
+    const vector<size_t>& members = grid.second;
+    vector<ProfileFitJob> ghJobs, andringaJobs;
+    for (size_t k : members) {
+      ghJobs.push_back(inputs[k].gh);
+      andringaJobs.push_back(inputs[k].andringa);
+    }
+
+    for (int v = 0; v < NumFitVariants; ++v) {
+      bool shift = (v == ShiftFit);
+      bool absoluteValue = (v == AbsFit);
+      if (allVariants || v == ShiftFit) {
+        vector<ProfileFit> gh = fitGaisserHillasBatch(grid.first, ghJobs, shift, absoluteValue);
+        for (size_t j = 0; j < members.size(); ++j) {
+          fits[members[j]].gh[v] = gh[j];
+        }
+      }
+      if (allVariants || v == PlainFit) {
+        vector<ProfileFit> andringa = fitAndringaBatch(grid.first, andringaJobs, shift, absoluteValue);
+        for (size_t j = 0; j < members.size(); ++j) {
+          fits[members[j]].andringa[v] = andringa[j];
+        }
+      }
+    }
+  }
+  return fits;
+}
+
+LongFits fitLongProfile(const LongProfile& profile, const LongSummary& summary, bool removeFinal20gcm2, bool allVariants) {
+  return fitLongProfiles(vector<LongProfile>(1, profile), vector<LongSummary>(1, summary), removeFinal20gcm2, allVariants)[0];
+}
@@ -0,0 +1,69 @@
+#ifndef LONGPROFILE_H
+#define LONGPROFILE_H
+
+#include <string>
+#include <vector>
+#include <istream>
+
+#include "profileFit.h"
+
+/// --------------------------------------------------------------------------------------------
+/// Longitudinal profiles from the CORSIKA .long files
+/// --------------------------------------------------------------------------------------------
+/// One profile per "LONGITUDINAL DISTRIBUTION" block of the file, i.e. per shower. Only the particle
+/// numbers are kept, the energy deposit table is skipped. The CORSIKA Gaisser-Hillas fit of the
+/// charged particles (PARAMETERS line) gives x0, xmax and lambda (first order only).
+struct LongProfile {
+  std::vector<double> depth;
+  std::vector<double> positrons;
+  std::vector<double> electrons;
+  std::vector<double> muPlus;
+  std::vector<double> muMinus;
+  std::vector<double> charged;
+  bool hasParameters = false;
+  double x0 = 0.;
+  double xmax = -1.;
+  double lambda = 0.;
+};
+
+/// Reads all profiles of a .long file, false if the file cannot be opened or holds no profile
+bool readLongFile(const std::string& fileName, std::vector<LongProfile>& profiles);
+
+/// The same from a stream, e.g. a .long member of a .tar.gz archive
+bool readLongProfiles(std::istream& in, std::vector<LongProfile>& profiles);
+
+/// Ground level and CORSIKA values of a profile, the xmax ... Lcorsika output columns
+struct LongSummary {
+  double xmax = -1.;       // CORSIKA fit, depth of the EM maximum if the fit failed
+  double nMuLong = 0.;     // mu+ + mu- at the depth closest to ground
+  double nEMxmax = 0.;     // e+ + e- at the EM maximum
+  double nEMLong = 0.;     // e+ + e- at the depth closest to ground
+  double Rcorsika = -1.;   // shape and width from the CORSIKA fit, -1 if it failed
+  double Lcorsika = -1.;
+};
+
+/// groundDepth is the vertical depth of the observation level in g/cm2, the slant depth of
+/// the ground is groundDepth / cos(zenith)
+LongSummary summarizeProfile(const LongProfile& profile, double zenith, double groundDepth);
+
+/// Gaisser-Hillas and Andringa fits of the e+ + e- profile, plain, with the +100 g/cm2 shift and
+/// with the absolute value in the power
+enum FitVariant {PlainFit, ShiftFit, AbsFit, NumFitVariants};
+
+struct LongFits {
+  ProfileFit gh[NumFitVariants];
+  ProfileFit andringa[NumFitVariants];
+};
+
+/// Fits the profile with the guesses of the python script (Nmax and Xmax from the profile, X0 = 0,
+/// lambda = 80 g/cm2), depths with no e+/- are left out. removeFinal20gcm2 drops the last 20 g/cm2
+/// where the shower front reaches the ground. Without allVariants only gh[ShiftFit] and
+/// andringa[PlainFit], the columns of the script, are fitted and the others are inf.
+LongFits fitLongProfile(const LongProfile& profile, const LongSummary& summary, bool removeFinal20gcm2, bool allVariants);
+
+/// The same for many showers at once: profiles with the same depths are fitted together in
+/// the lanes of the batched fitter, which is how the reader fits the showers of several files
+std::vector<LongFits> fitLongProfiles(const std::vector<LongProfile>& profiles, const std::vector<LongSummary>& summaries,
+                                      bool removeFinal20gcm2, bool allVariants);
+
+#endif
@@ -0,0 +1,213 @@
+#include "observables.h"
+
+#include <sstream>
+#include <math.h>
+using namespace std;
+
+/// Cumulative radial columns nX<50m ... nX<1000m (for the default binning), rounded as the counts
+static void radialColumns(const RadialBins& bins, const char* species, vector<ColumnSpec>& columns) {
+  for (int b = 0; b < bins.NumBins(); ++b) {
+    ostringstream name;
+    name << species << "<" << bins.UpperEdge(b) << "m";
+    columns.push_back({name.str(), ColumnType::Float64});
+  }
+}
+
+static void radialValues(const RadialBins& bins, vector<double>& values) {
+  vector<double> cumulative = bins.Cumulative();
+  for (size_t b = 0; b < cumulative.size(); ++b) {
+    values.push_back(round(cumulative[b]));
+  }
+}
+
+/// --------------------------------------------------------------------------------------------
+/// Muon counts
+/// --------------------------------------------------------------------------------------------
+void MuonCounts::Merge(const MuonCounts& other) {
+  nMuons += other.nMuons;
+  nMuons1 += other.nMuons1;
+  nMuons500 += other.nMuons500;
+  nMuons1000 += other.nMuons1000;
+}
+
+void MuonCounts::Reset() {
+  nMuons = nMuons1 = nMuons500 = nMuons1000 = 0.;
+}
+
+// Round the number of particles to nearest integer, since weights can be fractional in thinned showers
+void MuonCounts::Round() {
+  nMuons = round(nMuons);
+  nMuons1 = round(nMuons1);
+  nMuons500 = round(nMuons500);
+  nMuons1000 = round(nMuons1000);
+}
+
+void MuonCounts::Columns(vector<ColumnSpec>& columns) const {
+  columns.insert(columns.end(), {{"nMu", ColumnType::Float32}, {"nMu>1GeV", ColumnType::Float32},
+                                 {"nMu>500GeV", ColumnType::Float32}, {"nMu>1TeV", ColumnType::Float32}});
+}
+
+void MuonCounts::Values(vector<double>& values) const {
+  values.insert(values.end(), {nMuons, nMuons1, nMuons500, nMuons1000});
+}
+
+void MuonCounts::Save(vector<double>& state) const {
+  state.insert(state.end(), {nMuons, nMuons1, nMuons500, nMuons1000});
+}
+
+void MuonCounts::Load(const double*& state) {
+  nMuons = *state++;
+  nMuons1 = *state++;
+  nMuons500 = *state++;
+  nMuons1000 = *state++;
+}
+
+/// --------------------------------------------------------------------------------------------
+/// Thinning checks
+/// --------------------------------------------------------------------------------------------
+void MuonThinning::Merge(const MuonThinning& other) {
+  muonThin1 += other.muonThin1;
+  thinWeight1 += other.thinWeight1;
+  muonThin500 += other.muonThin500;
+  thinWeight500 += other.thinWeight500;
+}
+
+void MuonThinning::Reset() {
+  muonThin1 = muonThin500 = 0;
+  thinWeight1 = thinWeight500 = 0.;
+}
+
+void MuonThinning::Round() {
+  thinWeight1 = round(thinWeight1);
+  thinWeight500 = round(thinWeight500);
+}
+
+void MuonThinning::Columns(vector<ColumnSpec>& columns) const {
+  columns.insert(columns.end(), {{"nMuThin1", ColumnType::Int32}, {"thinW1", ColumnType::Float32},
+                                 {"nMuThin500", ColumnType::Int32}, {"thinW500", ColumnType::Float32}});
+}
+
+void MuonThinning::Values(vector<double>& values) const {
+  values.insert(values.end(), {(double) muonThin1, thinWeight1, (double) muonThin500, thinWeight500});
+}
+
+void MuonThinning::Save(vector<double>& state) const {
+  Values(state);
+}
+
+void MuonThinning::Load(const double*& state) {
+  muonThin1 = *state++;
+  thinWeight1 = *state++;
+  muonThin500 = *state++;
+  thinWeight500 = *state++;
+}
+
+/// --------------------------------------------------------------------------------------------
+/// Radial distributions and e+/- counts
+/// --------------------------------------------------------------------------------------------
+void MuonRadial::Setup(const RadialBins& binning) {
+  muDist = binning;
+  muDist.Clear();
+}
+
+void MuonRadial::Columns(vector<ColumnSpec>& columns) const {
+  radialColumns(muDist, "nMu", columns);
+}
+
+void MuonRadial::Values(vector<double>& values) const {
+  radialValues(muDist, values);
+}
+
+void MuonRadial::Save(vector<double>& state) const {
+  muDist.Save(state);
+}
+
+void MuonRadial::Load(const double*& state) {
+  muDist.Load(state);
+}
+
+void EMCounts::Round() {
+  nEM = round(nEM);
+}
+
+void EMCounts::Columns(vector<ColumnSpec>& columns) const {
+  columns.push_back({"nEM", ColumnType::Float32});
+}
+
+void EMCounts::Values(vector<double>& values) const {
+  values.push_back(nEM);
+}
+
+void EMCounts::Save(vector<double>& state) const {
+  state.push_back(nEM);
+}
+
+void EMCounts::Load(const double*& state) {
+  nEM = *state++;
+}
+
+void EMRadial::Setup(const RadialBins& binning) {
+  emDist = binning;
+  emDist.Clear();
+}
+
+void EMRadial::Columns(vector<ColumnSpec>& columns) const {
+  radialColumns(emDist, "nEM", columns);
+}
+
+void EMRadial::Values(vector<double>& values) const {
+  radialValues(emDist, values);
+}
+
+void EMRadial::Save(vector<double>& state) const {
+  emDist.Save(state);
+}
+
+void EMRadial::Load(const double*& state) {
+  emDist.Load(state);
+}
+
+/// --------------------------------------------------------------------------------------------
+/// Spectra
+/// --------------------------------------------------------------------------------------------
+/// 1000 bins each: 2 m wide out to 2 km, and log-uniform from 100 MeV to 100 TeV
+void SpeciesSpectra::EnableSpectra() {
+  spectra = true;
+  muLateral = histogram(0., 2000., 1000);
+  emLateral = histogram(0., 2000., 1000);
+  muEnergy = histogram(0.1, 1.e5, 1000, histogram::LogUniform);
+}
+
+void SpeciesSpectra::Merge(const SpeciesSpectra& other) {
+  if (spectra && other.spectra) {
+    muLateral.Add(other.muLateral);
+    emLateral.Add(other.emLateral);
+    muEnergy.Add(other.muEnergy);
+  }
+}
+
+void SpeciesSpectra::Reset() {
+  if (spectra) {
+    muLateral.Reset();
+    emLateral.Reset();
+    muEnergy.Reset();
+  }
+}
+
+void SpeciesSpectra::Save(vector<double>& state) const {
+  if (spectra) {
+    for (const histogram* h : {&muLateral, &emLateral, &muEnergy}) {
+      state.insert(state.end(), h->binContent.begin(), h->binContent.end());
+    }
+  }
+}
+
+void SpeciesSpectra::Load(const double*& state) {
+  if (spectra) {
+    for (histogram* h : {&muLateral, &emLateral, &muEnergy}) {
+      for (size_t b = 0; b < h->binContent.size(); ++b) {
+        h->binContent[b] = *state++;
+      }
+    }
+  }
+}
@@ -0,0 +1,283 @@
+#ifndef OBSERVABLES_H
+#define OBSERVABLES_H
+
+#include <vector>
+
+#include "particleKernel.h"
+#include "radialBins.h"
+#include "histogram.h"
+#include "columnFile.h"
+
+/// --------------------------------------------------------------------------------------------
+/// Observables filled in the particle loop
+/// --------------------------------------------------------------------------------------------
+/// An observable is a struct deriving from Observable that holds its own counts and hides the
+/// members it needs:
+///
+///   void Fill(const GroundParticle& p)     every muon and e+/- of a sub-block, in particle order
+///   void Merge(const X& other)             counts of another record range (--threads)
+///   void Reset()                           zero the counts, keep the binning
+///   void Round()                           before the output
+///   void Columns(columns) / Values(values) its output columns and their values, in the same order
+///   void Save(state) / Load(state)         its raw counts, for the checkpoints of a batch (--manifest)
+///
+/// ObservableSet<A, B, ...> derives from all of them and calls them in list order. The calls are
+/// resolved at compile time, so Fill of every observable is inlined into the one particle loop of
+/// FillBlock. An observable with optional = true is only filled once Enabled() returns true, sets
+/// without an enabled optional observable run a loop that does not contain them at all.
+/// A new observable is one struct here plus its entry in the ShowerCounters list (showerParser.h).
+
+/// What an observable gets to see of one classified particle
+struct GroundParticle {
+  ParticleKind kind;
+  float w;         // weight, 1 for standard showers
+  double ekin;     // kinetic energy assuming the muon mass, in GeV
+  double dist;     // distance to the shower axis in m
+};
+
+struct Observable {
+  static const bool optional = false;
+  bool Enabled() const { return true; };
+
+  void Setup(const RadialBins&) {};
+  void Reset() {};
+  void Round() {};
+  void Columns(std::vector<ColumnSpec>&) const {};
+  void Values(std::vector<double>&) const {};
+  void Save(std::vector<double>&) const {};
+  void Load(const double*&) {};
+};
+
+/// Muons (weighted) in total and above 1, 500 and 1000 GeV
+struct MuonCounts : Observable {
+  float nMuons = 0.;
+  float nMuons1 = 0.;
+  float nMuons500 = 0.;
+  float nMuons1000 = 0.;
+
+  void Fill(const GroundParticle& p) {
+    if (p.kind != MuonParticle) {
+      return;
+    }
+    nMuons += p.w;
+    if (p.ekin > 1.) {
+      nMuons1 += p.w;
+    }
+    if (p.ekin > 500.) {
+      nMuons500 += p.w;
+    }
+    if (p.ekin > 1000.) {
+      nMuons1000 += p.w;
+    }
+  };
+  void Merge(const MuonCounts& other);
+  void Reset();
+  void Round();
+  void Columns(std::vector<ColumnSpec>& columns) const;
+  void Values(std::vector<double>& values) const;
+  void Save(std::vector<double>& state) const;
+  void Load(const double*& state);
+};
+
+/// For testing thinning effects: number and summed weight of the muons with w > 1 above 1 and 500 GeV
+struct MuonThinning : Observable {
+  int muonThin1 = 0;
+  float thinWeight1 = 0.;
+
+  int muonThin500 = 0;
+  float thinWeight500 = 0.;
+
+  void Fill(const GroundParticle& p) {
+    if (p.kind != MuonParticle || !(p.w > 1.)) {
+      return;
+    }
+    if (p.ekin > 1.) {
+      muonThin1 += 1;
+      thinWeight1 += p.w;
+    }
+    if (p.ekin > 500.) {
+      muonThin500 += 1;
+      thinWeight500 += p.w;
+    }
+  };
+  void Merge(const MuonThinning& other);
+  void Reset();
+  void Round();
+  void Columns(std::vector<ColumnSpec>& columns) const;
+  void Values(std::vector<double>& values) const;
+  void Save(std::vector<double>& state) const;
+  void Load(const double*& state);
+};
+
+/// Muons per radial bin, the nMu<Rm columns are its prefix sums
+struct MuonRadial : Observable {
+  RadialBins muDist;
+
+  void Fill(const GroundParticle& p) {
+    if (p.kind == MuonParticle) {
+      muDist.Fill(p.dist, p.w);
+    }
+  };
+  void Setup(const RadialBins& binning);
+  void Merge(const MuonRadial& other) { muDist.Merge(other.muDist); };
+  void Reset() { muDist.Clear(); };
+  void Columns(std::vector<ColumnSpec>& columns) const;
+  void Values(std::vector<double>& values) const;
+  void Save(std::vector<double>& state) const;
+  void Load(const double*& state);
+};
+
+/// e+/- (weighted)
+struct EMCounts : Observable {
+  float nEM = 0.;
+
+  void Fill(const GroundParticle& p) {
+    if (p.kind == EMParticle) {
+      nEM += p.w;
+    }
+  };
+  void Merge(const EMCounts& other) { nEM += other.nEM; };
+  void Reset() { nEM = 0.; };
+  void Round();
+  void Columns(std::vector<ColumnSpec>& columns) const;
+  void Values(std::vector<double>& values) const;
+  void Save(std::vector<double>& state) const;
+  void Load(const double*& state);
+};
+
+/// e+/- per radial bin, the nEM<Rm columns are its prefix sums
+struct EMRadial : Observable {
+  RadialBins emDist;
+
+  void Fill(const GroundParticle& p) {
+    if (p.kind == EMParticle) {
+      emDist.Fill(p.dist, p.w);
+    }
+  };
+  void Setup(const RadialBins& binning);
+  void Merge(const EMRadial& other) { emDist.Merge(other.emDist); };
+  void Reset() { emDist.Clear(); };
+  void Columns(std::vector<ColumnSpec>& columns) const;
+  void Values(std::vector<double>& values) const;
+  void Save(std::vector<double>& state) const;
+  void Load(const double*& state);
+};
+
+/// Fine-grained spectra per species (--spectra), dumped into their own file instead of columns
+struct SpeciesSpectra : Observable {
+  static const bool optional = true;
+  bool spectra = false;
+  histogram muLateral;   // muons vs core distance in m
+  histogram emLateral;   // e+/- vs core distance in m
+  histogram muEnergy;    // muons vs kinetic energy in GeV
+
+  bool Enabled() const { return spectra; };
+  void Fill(const GroundParticle& p) {
+    if (p.kind == MuonParticle) {
+      muLateral.Fill(p.dist, p.w);
+      muEnergy.Fill(p.ekin, p.w);
+    } else if (p.kind == EMParticle) {
+      emLateral.Fill(p.dist, p.w);
+    }
+  };
+  void EnableSpectra();
+  void Merge(const SpeciesSpectra& other);
+  void Reset();
+  void Save(std::vector<double>& state) const;
+  void Load(const double*& state);
+};
+
+/// --------------------------------------------------------------------------------------------
+/// Compile-time list of observables
+/// --------------------------------------------------------------------------------------------
+template <class... Obs>
+struct ObservableSet : Obs... {
+  /// Fills every observable with the muons and e+/- of one sub-block
+  void FillBlock(const BlockLanes& lanes, int nParticles) {
+    if (AnyOptionalEnabled<Obs...>()) {
+      FillLanes<true>(lanes, nParticles);
+    } else {
+      FillLanes<false>(lanes, nParticles);
+    }
+  };
+
+  void Setup(const RadialBins& binning) { SetupEach<Obs...>(binning); };
+  void Merge(const ObservableSet& other) { MergeEach<Obs...>(other); };
+  void Reset() { ResetEach<Obs...>(); };
+  void Round() { RoundEach<Obs...>(); };
+  void Columns(std::vector<ColumnSpec>& columns) const { ColumnsEach<Obs...>(columns); };
+  void Values(std::vector<double>& values) const { ValuesEach<Obs...>(values); };
+  void Save(std::vector<double>& state) const { SaveEach<Obs...>(state); };
+  void Load(const double*& state) { LoadEach<Obs...>(state); };
+
+private:
+  template <bool withOptional>
+  void FillLanes(const BlockLanes& lanes, int nParticles) {
+    for (int p = 0; p < nParticles; p++) {
+      if (lanes.kind[p] == OtherParticle) {
+        continue;
+      }
+      GroundParticle particle = {(ParticleKind) lanes.kind[p], lanes.w[p], lanes.ekin[p], lanes.dist[p]};
+      FillEach<withOptional, Obs...>(particle);
+    }
+  };
+
+  // One overload per list length, the empty list ends the recursion
+  template <bool withOptional>
+  void FillEach(const GroundParticle&) {};
+  template <bool withOptional, class First, class... Rest>
+  void FillEach(const GroundParticle& p) {
+    // withOptional and optional are constants, so a non-optional Fill is called unconditionally
+    if ( !First::optional || (withOptional && First::Enabled()) ) {
+      First::Fill(p);
+    }
+    FillEach<withOptional, Rest...>(p);
+  };
+
+  template <int none = 0>
+  bool AnyOptionalEnabled() const { return false; };
+  template <class First, class... Rest>
+  bool AnyOptionalEnabled() const { return (First::optional && First::Enabled()) || AnyOptionalEnabled<Rest...>(); };
+
+  template <int none = 0>
+  void SetupEach(const RadialBins&) {};
+  template <class First, class... Rest>
+  void SetupEach(const RadialBins& binning) { First::Setup(binning); SetupEach<Rest...>(binning); };
+
+  template <int none = 0>
+  void MergeEach(const ObservableSet&) {};
+  template <class First, class... Rest>
+  void MergeEach(const ObservableSet& other) { First::Merge(static_cast<const First&>(other)); MergeEach<Rest...>(other); };
+
+  template <int none = 0>
+  void ResetEach() {};
+  template <class First, class... Rest>
+  void ResetEach() { First::Reset(); ResetEach<Rest...>(); };
+
+  template <int none = 0>
+  void RoundEach() {};
+  template <class First, class... Rest>
+  void RoundEach() { First::Round(); RoundEach<Rest...>(); };
+
+  template <int none = 0>
+  void ColumnsEach(std::vector<ColumnSpec>&) const {};
+  template <class First, class... Rest>
+  void ColumnsEach(std::vector<ColumnSpec>& columns) const { First::Columns(columns); ColumnsEach<Rest...>(columns); };
+
+  template <int none = 0>
+  void ValuesEach(std::vector<double>&) const {};
+  template <class First, class... Rest>
+  void ValuesEach(std::vector<double>& values) const { First::Values(values); ValuesEach<Rest...>(values); };
+
+  template <int none = 0>
+  void SaveEach(std::vector<double>&) const {};
+  template <class First, class... Rest>
+  void SaveEach(std::vector<double>& state) const { First::Save(state); SaveEach<Rest...>(state); };
+
+  template <int none = 0>
+  void LoadEach(const double*&) {};
+  template <class First, class... Rest>
+  void LoadEach(const double*& state) { First::Load(state); LoadEach<Rest...>(state); };
+};
+
+#endif
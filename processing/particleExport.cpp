@@ -0,0 +1,113 @@
+#include "particleExport.h"
+
+#include <sstream>
+#include <cstdlib>
+#include <math.h>
+using namespace std;
+
+static const int kMaxParticleID = 10000;
+
+/// Entries that are not particles at ground: additional muon information (75, 76), decayed muon
+/// origin (85, 86, 95, 96) and Cherenkov photon bunches (9900)
+static bool isParticle(int id) {
+  return id > 0 && id < kMaxParticleID && id != 75 && id != 76 && id != 85 && id != 86 && id != 95 && id != 96 && id != 9900;
+}
+
+bool parseSpeciesList(const string& list, vector<int>& species) {
+  istringstream in(list);
+  string name;
+  while (getline(in, name, ',')) {
+    if (name == "gamma") {
+      species.push_back(1);
+    } else if (name == "em") {
+      species.insert(species.end(), {2, 3});
+    } else if (name == "mu") {
+      species.insert(species.end(), {5, 6});
+    } else if (name == "pi") {
+      species.insert(species.end(), {8, 9});
+    } else if (name == "n") {
+      species.push_back(13);
+    } else if (name == "p") {
+      species.push_back(14);
+    } else {
+      char* end;
+      long id = strtol(name.c_str(), &end, 10);
+      if (name.empty() || *end != 0 || !isParticle(id)) {
+        return false;
+      }
+      species.push_back(id);
+    }
+  }
+  return !species.empty();
+}
+
+double particleMass(int id) {
+  switch (id) {
+    case 1: return 0.;                        // gamma
+    case 2: case 3: return 0.51099895e-3;     // e+, e-
+    case 5: case 6: return 0.105658357;       // mu+, mu-, the mass the counters use
+    case 7: return 0.1349768;                 // pi0
+    case 8: case 9: return 0.13957039;        // pi+, pi-
+    case 10: case 16: return 0.497611;        // K0L, K0S
+    case 11: case 12: return 0.493677;        // K+, K-
+    case 13: case 25: return 0.93956542;      // n, nbar
+    case 14: case 15: return 0.93827209;      // p, pbar
+    case 66: case 67: case 68: case 69: return 0.;   // neutrinos
+  }
+  if (id >= 200 && id < 6000) {
+    return (id / 100) * 0.93149410;           // nucleus A * 100 + Z, A atomic mass units
+  }
+  return 0.;
+}
+
+static vector<ColumnSpec> exportColumns() {
+  return {{"event", ColumnType::Int32}, {"id", ColumnType::Int32},
+          {"px(GeV)", ColumnType::Float32}, {"py(GeV)", ColumnType::Float32}, {"pz(GeV)", ColumnType::Float32},
+          {"x(m)", ColumnType::Float32}, {"y(m)", ColumnType::Float32}, {"t(ns)", ColumnType::Float32},
+          {"weight", ColumnType::Float32}, {"ekin(GeV)", ColumnType::Float64}, {"r(m)", ColumnType::Float64}};
+}
+
+ParticleExporter::ParticleExporter(const string& fileName, const ExportFilter& filter_,
+                                   const vector<pair<string, string> >& metadata)
+  : writer(fileName, exportColumns(), metadata), selected(kMaxParticleID, 0), filter(filter_), row(writer.NumColumns()) {
+  for (int id = 0; id < kMaxParticleID; ++id) {
+    selected[id] = isParticle(id) && filter.species.empty();
+  }
+  for (int id : filter.species) {
+    selected[id] = 1;
+  }
+}
+
+void ParticleExporter::AddBlock(const float* block, int nParticles, int stride, const BlockLanes& lanes, int event) {
+  for (int p = 0; p < nParticles; ++p) {
+    const float* part = block + p * stride;
+    // Particle description id * 1000 + hadronic generation * 10 + observation level
+    int id = (int) (part[0] / 1000.f);
+    if (id <= 0 || id >= kMaxParticleID || !selected[id]) {
+      continue;
+    }
+    double dist = lanes.dist[p];
+    if ( !(dist >= filter.rMin && dist <= filter.rMax) ) {
+      continue;
+    }
+    double m = particleMass(id);
+    double p2 = (double) part[1] * part[1] + (double) part[2] * part[2] + (double) part[3] * part[3];
+    double ekin = sqrt(p2 + m * m) - m;
+    if ( !(ekin >= filter.eMin && ekin <= filter.eMax) ) {
+      continue;
+    }
+    row[0] = event;
+    row[1] = id;
+    row[2] = part[1];
+    row[3] = part[2];
+    row[4] = part[3];
+    row[5] = part[4] / 100.;
+    row[6] = part[5] / 100.;
+    row[7] = part[6];
+    row[8] = lanes.w[p];
+    row[9] = ekin;
+    row[10] = dist;
+    writer.AddRow(row);
+    nExported += 1;
+  }
+}
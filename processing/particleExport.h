@@ -0,0 +1,54 @@
+#ifndef PARTICLEEXPORT_H
+#define PARTICLEEXPORT_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <limits>
+
+#include "columnFile.h"
+#include "particleKernel.h"
+
+/// --------------------------------------------------------------------------------------------
+/// Export of single ground particles (--export)
+/// --------------------------------------------------------------------------------------------
+/// Particles passing the filter are streamed into a column file (columnFile.h), one row per
+/// particle: event, id, px, py, pz (GeV), x, y (m), t (ns), weight, ekin (GeV) and the distance
+/// to the shower axis r (m, as for the nMu<Rm columns). Only one row group is held in memory.
+struct ExportFilter {
+  std::vector<int> species;   // CORSIKA particle ids, empty for every particle
+  double eMin = 0.;           // kinetic energy in GeV
+  double eMax = std::numeric_limits<double>::infinity();
+  double rMin = 0.;           // distance to the shower axis in m
+  double rMax = std::numeric_limits<double>::infinity();
+};
+
+/// Comma separated CORSIKA ids or the names gamma, em (2, 3), mu (5, 6), pi (8, 9), p (14), n (13),
+/// false on anything else
+bool parseSpeciesList(const std::string& list, std::vector<int>& species);
+
+/// Rest mass in GeV of a CORSIKA particle id (nuclei A * 100 + Z), 0 for unknown ids
+double particleMass(int id);
+
+class ParticleExporter {
+public:
+  ParticleExporter(const std::string& fileName, const ExportFilter& filter,
+                   const std::vector<std::pair<std::string, std::string> >& metadata);
+
+  /// The particles of one sub-block, lanes as filled by classifyBlock. event counts the showers of
+  /// the file from 1 (0 for particles before the first EVTH), the order of the rows and .long profiles.
+  void AddBlock(const float* block, int nParticles, int stride, const BlockLanes& lanes, int event);
+
+  bool Good() const { return writer.Good(); };
+  bool Close() { return writer.Close(); };
+  size_t NumExported() const { return nExported; };
+
+private:
+  ColumnWriter writer;
+  std::vector<char> selected;   // by particle id
+  ExportFilter filter;
+  std::vector<double> row;
+  size_t nExported = 0;
+};
+
+#endif
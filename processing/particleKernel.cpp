@@ -0,0 +1,269 @@
+#include "particleKernel.h"
+
+#include <math.h>
+
+// GCC 12 warns about the deliberately undefined upper halves inside its own avx512 headers (GCC bug 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+
+static const double massMu = 0.105658357;
+
+EventGeometry eventGeometry(double zenith, double azimuth, bool curved, double obslev) {
+  EventGeometry geo;
+  geo.axis[0] = sin(zenith) * cos(azimuth);
+  geo.axis[1] = sin(zenith) * sin(azimuth);
+  geo.axis[2] = -cos(zenith);
+
+  if (curved) {
+    double radEarthPlusObslev = radEarth + obslev;
+    geo.curvature = 1. / (4. * radEarthPlusObslev * radEarthPlusObslev);
+  } else {
+    geo.a = geo.axis[0] * geo.axis[0];
+    geo.b = geo.axis[1] * geo.axis[1];
+    geo.c = geo.axis[0] * geo.axis[1];
+  }
+  return geo;
+}
+
+/// Particle id / 1000 is 5 or 6 for muons and 2 or 3 for e+/-, i.e. fixed ranges of the float id
+static inline unsigned char kindOf(float particle_id) {
+  if (particle_id >= 5000.f && particle_id < 7000.f) {
+    return MuonParticle;
+  }
+  if (particle_id >= 2000.f && particle_id < 4000.f) {
+    return EMParticle;
+  }
+  return OtherParticle;
+}
+
+template <class Layout>
+static void classifyBlockScalar(const float* block, const EventGeometry& geo, BlockLanes& lanes) {
+  for (int p = 0; p < Layout::particlesPerBlock; ++p) {
+    const float* part = block + p * Layout::particleWords;
+    float px = part[1];
+    float py = part[2];
+    float pz = part[3];
+    float x  = part[4];
+    float y  = part[5];
+
+    lanes.kind[p] = kindOf(part[0]);
+    lanes.w[p] = Layout::weighted ? part[7] : 1.0f;
+
+    float p2 = px * px + py * py + pz * pz;
+    lanes.ekin[p] = sqrt( (double) p2 + massMu * massMu ) - massMu;
+
+    float xx = x * x;
+    float yy = y * y;
+    float xy2 = 2 * x * y;
+    double r2 = (double) (xx + yy);
+    double s = r2 * geo.curvature;
+    lanes.dist[p] = sqrt( r2 - geo.a * xx - geo.b * yy - geo.c * xy2 ) * (1. - s * (1. / 6.) + s * s * (1. / 120.)) / 100.;
+  }
+}
+
+/// --------------------------------------------------------------------------------------------
+/// AVX2: 8 particles per iteration, 2 x 4 lanes for the double precision part
+/// --------------------------------------------------------------------------------------------
+__attribute__((target("avx2")))
+static inline void kindMask(__m256 pid, unsigned char* kind) {
+  int muon = _mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(pid, _mm256_set1_ps(5000.f), _CMP_GE_OQ),
+                                              _mm256_cmp_ps(pid, _mm256_set1_ps(7000.f), _CMP_LT_OQ)));
+  int em = _mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(pid, _mm256_set1_ps(2000.f), _CMP_GE_OQ),
+                                            _mm256_cmp_ps(pid, _mm256_set1_ps(4000.f), _CMP_LT_OQ)));
+  for (int l = 0; l < 8; ++l) {
+    kind[l] = ((muon >> l) & 1) ? MuonParticle : (((em >> l) & 1) ? EMParticle : OtherParticle);
+  }
+}
+
+/// ekinMu and dist in double precision for 4 lanes, from the float sums of squares
+__attribute__((target("avx2")))
+static inline void ekinDist4(__m128 p2, __m128 xx, __m128 yy, __m128 r2, __m128 xy2,
+                             const EventGeometry& geo, double* ekin, double* dist) {
+  __m256d e = _mm256_sub_pd(_mm256_sqrt_pd(_mm256_add_pd(_mm256_cvtps_pd(p2), _mm256_set1_pd(massMu * massMu))),
+                            _mm256_set1_pd(massMu));
+
+  __m256d d2 = _mm256_sub_pd(_mm256_cvtps_pd(r2), _mm256_mul_pd(_mm256_set1_pd(geo.a), _mm256_cvtps_pd(xx)));
+  d2 = _mm256_sub_pd(d2, _mm256_mul_pd(_mm256_set1_pd(geo.b), _mm256_cvtps_pd(yy)));
+  d2 = _mm256_sub_pd(d2, _mm256_mul_pd(_mm256_set1_pd(geo.c), _mm256_cvtps_pd(xy2)));
+
+  __m256d s = _mm256_mul_pd(_mm256_cvtps_pd(r2), _mm256_set1_pd(geo.curvature));
+  __m256d series = _mm256_sub_pd(_mm256_set1_pd(1.), _mm256_mul_pd(s, _mm256_set1_pd(1. / 6.)));
+  series = _mm256_add_pd(series, _mm256_mul_pd(_mm256_mul_pd(s, s), _mm256_set1_pd(1. / 120.)));
+
+  _mm256_store_pd(ekin, e);
+  _mm256_store_pd(dist, _mm256_div_pd(_mm256_mul_pd(_mm256_sqrt_pd(d2), series), _mm256_set1_pd(100.)));
+}
+
+template <class Layout>
+__attribute__((target("avx2")))
+static void classifyBlockAVX2(const float* block, const EventGeometry& geo, BlockLanes& lanes) {
+  const int nParticles = Layout::particlesPerBlock;
+  const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256i lastParticle = _mm256_set1_epi32(nParticles - 1);
+  const __m256i vstride = _mm256_set1_epi32(Layout::particleWords);
+
+  for (int p = 0; p < nParticles; p += 8) {
+    // Lanes past the last particle re-read the last particle, their results are never used
+    __m256i particle = _mm256_min_epi32(_mm256_add_epi32(_mm256_set1_epi32(p), lane), lastParticle);
+    __m256i idx = _mm256_mullo_epi32(particle, vstride);
+
+    __m256 pid = _mm256_i32gather_ps(block + 0, idx, 4);
+    __m256 px  = _mm256_i32gather_ps(block + 1, idx, 4);
+    __m256 py  = _mm256_i32gather_ps(block + 2, idx, 4);
+    __m256 pz  = _mm256_i32gather_ps(block + 3, idx, 4);
+    __m256 x   = _mm256_i32gather_ps(block + 4, idx, 4);
+    __m256 y   = _mm256_i32gather_ps(block + 5, idx, 4);
+    __m256 w   = Layout::weighted ? _mm256_i32gather_ps(block + 7, idx, 4) : _mm256_set1_ps(1.0f);
+
+    kindMask(pid, &lanes.kind[p]);
+    _mm256_store_ps(&lanes.w[p], w);
+
+    __m256 p2  = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, px), _mm256_mul_ps(py, py)), _mm256_mul_ps(pz, pz));
+    __m256 xx  = _mm256_mul_ps(x, x);
+    __m256 yy  = _mm256_mul_ps(y, y);
+    __m256 r2  = _mm256_add_ps(xx, yy);
+    __m256 xy2 = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(2.f), x), y);
+
+    ekinDist4(_mm256_castps256_ps128(p2), _mm256_castps256_ps128(xx), _mm256_castps256_ps128(yy),
+              _mm256_castps256_ps128(r2), _mm256_castps256_ps128(xy2), geo, &lanes.ekin[p], &lanes.dist[p]);
+    ekinDist4(_mm256_extractf128_ps(p2, 1), _mm256_extractf128_ps(xx, 1), _mm256_extractf128_ps(yy, 1),
+              _mm256_extractf128_ps(r2, 1), _mm256_extractf128_ps(xy2, 1), geo, &lanes.ekin[p + 4], &lanes.dist[p + 4]);
+  }
+}
+
+/// --------------------------------------------------------------------------------------------
+/// AVX-512: 16 particles per iteration, 2 x 8 lanes for the double precision part
+/// --------------------------------------------------------------------------------------------
+__attribute__((target("avx512f")))
+static inline __m256 lowHalf(__m512 v) {
+  return _mm512_castps512_ps256(v);
+}
+
+__attribute__((target("avx512f")))
+static inline __m256 highHalf(__m512 v) {
+  return _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1));
+}
+
+/// ekinMu and dist in double precision for 8 lanes, from the float sums of squares
+__attribute__((target("avx512f")))
+static inline void ekinDist8(__m256 p2, __m256 xx, __m256 yy, __m256 r2, __m256 xy2,
+                             const EventGeometry& geo, double* ekin, double* dist) {
+  __m512d e = _mm512_sub_pd(_mm512_sqrt_pd(_mm512_add_pd(_mm512_cvtps_pd(p2), _mm512_set1_pd(massMu * massMu))),
+                            _mm512_set1_pd(massMu));
+
+  __m512d d2 = _mm512_sub_pd(_mm512_cvtps_pd(r2), _mm512_mul_pd(_mm512_set1_pd(geo.a), _mm512_cvtps_pd(xx)));
+  d2 = _mm512_sub_pd(d2, _mm512_mul_pd(_mm512_set1_pd(geo.b), _mm512_cvtps_pd(yy)));
+  d2 = _mm512_sub_pd(d2, _mm512_mul_pd(_mm512_set1_pd(geo.c), _mm512_cvtps_pd(xy2)));
+
+  __m512d s = _mm512_mul_pd(_mm512_cvtps_pd(r2), _mm512_set1_pd(geo.curvature));
+  __m512d series = _mm512_sub_pd(_mm512_set1_pd(1.), _mm512_mul_pd(s, _mm512_set1_pd(1. / 6.)));
+  series = _mm512_add_pd(series, _mm512_mul_pd(_mm512_mul_pd(s, s), _mm512_set1_pd(1. / 120.)));
+
+  _mm512_store_pd(ekin, e);
+  _mm512_store_pd(dist, _mm512_div_pd(_mm512_mul_pd(_mm512_sqrt_pd(d2), series), _mm512_set1_pd(100.)));
+}
+
+template <class Layout>
+__attribute__((target("avx512f")))
+static void classifyBlockAVX512(const float* block, const EventGeometry& geo, BlockLanes& lanes) {
+  const int nParticles = Layout::particlesPerBlock;
+  const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  const __m512i lastParticle = _mm512_set1_epi32(nParticles - 1);
+  const __m512i vstride = _mm512_set1_epi32(Layout::particleWords);
+
+  for (int p = 0; p < nParticles; p += 16) {
+    // Lanes past the last particle re-read the last particle, their results are never used
+    __m512i particle = _mm512_min_epi32(_mm512_add_epi32(_mm512_set1_epi32(p), lane), lastParticle);
+    __m512i idx = _mm512_mullo_epi32(particle, vstride);
+
+    __m512 pid = _mm512_i32gather_ps(idx, block + 0, 4);
+    __m512 px  = _mm512_i32gather_ps(idx, block + 1, 4);
+    __m512 py  = _mm512_i32gather_ps(idx, block + 2, 4);
+    __m512 pz  = _mm512_i32gather_ps(idx, block + 3, 4);
+    __m512 x   = _mm512_i32gather_ps(idx, block + 4, 4);
+    __m512 y   = _mm512_i32gather_ps(idx, block + 5, 4);
+    __m512 w   = Layout::weighted ? _mm512_i32gather_ps(idx, block + 7, 4) : _mm512_set1_ps(1.0f);
+
+    __mmask16 muon = _mm512_cmp_ps_mask(pid, _mm512_set1_ps(5000.f), _CMP_GE_OQ)
+                   & _mm512_cmp_ps_mask(pid, _mm512_set1_ps(7000.f), _CMP_LT_OQ);
+    __mmask16 em = _mm512_cmp_ps_mask(pid, _mm512_set1_ps(2000.f), _CMP_GE_OQ)
+                 & _mm512_cmp_ps_mask(pid, _mm512_set1_ps(4000.f), _CMP_LT_OQ);
+    for (int l = 0; l < 16; ++l) {
+      lanes.kind[p + l] = ((muon >> l) & 1) ? MuonParticle : (((em >> l) & 1) ? EMParticle : OtherParticle);
+    }
+    _mm512_store_ps(&lanes.w[p], w);
+
+    __m512 p2  = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(px, px), _mm512_mul_ps(py, py)), _mm512_mul_ps(pz, pz));
+    __m512 xx  = _mm512_mul_ps(x, x);
+    __m512 yy  = _mm512_mul_ps(y, y);
+    __m512 r2  = _mm512_add_ps(xx, yy);
+    __m512 xy2 = _mm512_mul_ps(_mm512_mul_ps(_mm512_set1_ps(2.f), x), y);
+
+    ekinDist8(lowHalf(p2), lowHalf(xx), lowHalf(yy), lowHalf(r2), lowHalf(xy2), geo, &lanes.ekin[p], &lanes.dist[p]);
+    ekinDist8(highHalf(p2), highHalf(xx), highHalf(yy), highHalf(r2), highHalf(xy2), geo, &lanes.ekin[p + 8], &lanes.dist[p + 8]);
+  }
+}
+
+/// --------------------------------------------------------------------------------------------
+/// Runtime dispatch
+/// --------------------------------------------------------------------------------------------
+/// Every kernel is instantiated for both record layouts, the layout picks the instantiation
+typedef void (*ClassifyFunction)(const float*, const EventGeometry&, BlockLanes&);
+
+struct KernelChoice {
+  ClassifyFunction thinned;
+  ClassifyFunction standard;
+  const char* name;
+};
+
+static const KernelChoice scalarKernel = {classifyBlockScalar<ThinnedLayout>, classifyBlockScalar<StandardLayout>, "scalar"};
+static const KernelChoice avx2Kernel = {classifyBlockAVX2<ThinnedLayout>, classifyBlockAVX2<StandardLayout>, "avx2"};
+static const KernelChoice avx512Kernel = {classifyBlockAVX512<ThinnedLayout>, classifyBlockAVX512<StandardLayout>, "avx512"};
+
+static KernelChoice bestKernel() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return avx512Kernel;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return avx2Kernel;
+  }
+  return scalarKernel;
+}
+
+static KernelChoice& currentKernel() {
+  static KernelChoice kernel = bestKernel();
+  return kernel;
+}
+
+template <class Layout>
+void classifyBlock(const float* block, const EventGeometry& geo, BlockLanes& lanes) {
+  const KernelChoice& kernel = currentKernel();
+  (Layout::weighted ? kernel.thinned : kernel.standard)(block, geo, lanes);
+}
+
+template void classifyBlock<ThinnedLayout>(const float*, const EventGeometry&, BlockLanes&);
+template void classifyBlock<StandardLayout>(const float*, const EventGeometry&, BlockLanes&);
+
+bool selectParticleKernel(const std::string& name) {
+  __builtin_cpu_init();
+  if (name == "auto") {
+    currentKernel() = bestKernel();
+  } else if (name == "scalar") {
+    currentKernel() = scalarKernel;
+  } else if (name == "avx2" && __builtin_cpu_supports("avx2")) {
+    currentKernel() = avx2Kernel;
+  } else if (name == "avx512" && __builtin_cpu_supports("avx512f")) {
+    currentKernel() = avx512Kernel;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* particleKernelName() {
+  return currentKernel().name;
+}
@@ -0,0 +1,54 @@
+#ifndef PARTICLEKERNEL_H
+#define PARTICLEKERNEL_H
+
+#include <string>
+
+#include "recordLayout.h"
+
+/// --------------------------------------------------------------------------------------------
+/// Vectorized classification of the particles of one sub-block
+/// --------------------------------------------------------------------------------------------
+/// The particles of a sub-block are gathered into SoA lanes, classified as muon (id 5, 6) or
+/// e+/- (id 2, 3) by mask, and ekinMu and the core distance are computed for all lanes at once.
+/// The accumulation into the counters stays a plain loop over the lanes, in particle order.
+
+const int kMaxBlockParticles = 39;  // 312 / 8 for thinned, 273 / 7 for standard
+const int kBlockLanes = 48;         // kMaxBlockParticles rounded up to a multiple of 16 lanes
+
+enum ParticleKind { OtherParticle = 0, MuonParticle = 1, EMParticle = 2 };
+
+struct BlockLanes {
+  alignas(64) double dist[kBlockLanes];   // distance to the shower axis in m
+  alignas(64) double ekin[kBlockLanes];   // kinetic energy assuming the muon mass, in GeV
+  alignas(64) float w[kBlockLanes];       // particle weight, 1 for standard showers
+  unsigned char kind[kBlockLanes];
+};
+
+/// Geometry of one event, built once at EVTH so that the particle kernel needs no transcendental calls.
+/// Flat observation level: dist^2 = x^2 + y^2 - a x^2 - b y^2 - c 2xy  (in cm^2), i.e. |d|^2 - (d . n)^2
+/// with the shower axis n = (sin(zenith)*cos(azimuth), sin(zenith)*sin(azimuth), -cos(zenith)).
+/// Curved observation level: the distance is the chord 2 R sin(r / 2R) with R = R_earth + obslev and
+/// r = sqrt(x^2 + y^2), evaluated as r (1 - s/6 + s^2/120) with s = r^2 / (2R)^2 (s < 1e-6 up to 10 km).
+/// Both cases share one formula, for a flat level the curvature s vanishes and for a curved one a, b, c do.
+struct EventGeometry {
+  double axis[3] = {0., 0., -1.};  // unit vector along the shower axis
+  double a = 0.;                   // projection onto the shower plane, a = nx^2, b = ny^2, c = nx ny
+  double b = 0.;
+  double c = 0.;
+  double curvature = 0.;           // 1 / (2R)^2 in 1/cm^2, 0 for a flat observation level
+};
+
+const double radEarth = 637131500.;  // Earth radius used by CORSIKA, in cm
+
+EventGeometry eventGeometry(double zenith, double azimuth, bool curved, double obslev);
+
+/// Fills lanes 0..Layout::particlesPerBlock-1 from the particles of the sub-block starting at block,
+/// instantiated for ThinnedLayout and StandardLayout (recordLayout.h)
+template <class Layout>
+void classifyBlock(const float* block, const EventGeometry& geo, BlockLanes& lanes);
+
+/// Selects the kernel by name ("scalar", "avx2", "avx512" or "auto"), returns false if not available here
+bool selectParticleKernel(const std::string& name);
+const char* particleKernelName();
+
+#endif
@@ -0,0 +1,1035 @@
+#include "profileFit.h"
+
+#include <limits>
+#include <algorithm>
+#include <math.h>
+
+// GCC 12 warns about the deliberately undefined upper halves inside its own avx512 headers (GCC bug 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+using namespace std;
+
+static const int kMaxPar = 4;
+static const double kTolerance = 1.49012e-8;   // ftol and xtol of curve_fit
+
+static int numParameters(ProfileModel model) {
+  return (model == ProfileModel::GaisserHillas) ? 4 : 3;
+}
+
+/// --------------------------------------------------------------------------------------------
+/// Model values and analytic derivatives
+/// --------------------------------------------------------------------------------------------
+/// Both models are evaluated as exp(log(...)), the derivatives follow from d log f.
+static double evalModel(ProfileModel model, bool absoluteValue, double X, const double* p, double* grad) {
+  const double nan = numeric_limits<double>::quiet_NaN();
+
+  if (model == ProfileModel::GaisserHillas) {
+    const double Nmax = p[0], Xmax = p[1], X0 = p[2], lamb = p[3];
+    const double D = Xmax - X0;
+    const double u = X - X0;
+    const double base = (absoluteValue ? fabs(u) : u) / D;
+    if ( !(base > 0.) ) {
+      // 0^(D/lambda) is 0 for a positive power, anything else (base < 0, NaN) is undefined
+      if (base == 0. && D / lamb > 0.) {
+        fill(grad, grad + 4, 0.);
+        return 0.;
+      }
+      return nan;
+    }
+    const double lt = log(base);
+    const double e = exp(D / lamb * lt + (Xmax - X) / lamb);
+    const double f = Nmax * e;
+    grad[0] = e;
+    grad[1] = f * lt / lamb;
+    grad[2] = f * (1. / lamb - lt / lamb - D / (lamb * u));
+    grad[3] = -f * (D * lt + Xmax - X) / (lamb * lamb);
+    return f;
+  }
+
+  const double Xmax = p[0], R = p[1], L = p[2];
+  const double z = X - Xmax;
+  const double v = 1. + R * z / L;
+  const double base = absoluteValue ? fabs(v) : v;
+  if ( !(base > 0.) ) {
+    if (base == 0. && R != 0.) {
+      fill(grad, grad + 3, 0.);
+      return 0.;
+    }
+    return nan;
+  }
+  const double lv = log(base);
+  const double f = exp(lv / (R * R) - z / (L * R));
+  grad[0] = f * z / (L * L * v);
+  grad[1] = f * (-2. * lv / (R * R * R) + z / (L * R * R * v) + z / (L * R * R));
+  grad[2] = f * z / (L * L * R) * (1. - 1. / v);
+  return f;
+}
+
+/// --------------------------------------------------------------------------------------------
+/// Evaluation kernels
+/// --------------------------------------------------------------------------------------------
+/// All lanes of a batch are evaluated at every point of the grid. Layouts, lane l innermost:
+/// y, w and r are [point][lane], p is [parameter][lane] and J is [point][parameter][lane].
+/// w = 1 / sigma, points with w == 0 get a zero residual and Jacobian row. Lanes outside of
+/// laneMask are not needed, a kernel may skip them.
+typedef void (*FitEvalFunction)(ProfileModel, bool, const double*, size_t, const double*, const double*,
+                                const double*, bool, unsigned, double*, double*);
+
+static void evalLanesScalar(ProfileModel model, bool absoluteValue, const double* x, size_t m, const double* y,
+                            const double* w, const double* p, bool jacobian, unsigned laneMask,
+                            double* r, double* J) {
+  const int n = numParameters(model);
+  for (int l = 0; l < kFitLanes; ++l) {
+    if ( !(laneMask & (1u << l)) ) {
+      continue;
+    }
+    double lanePar[kMaxPar], grad[kMaxPar];
+    for (int k = 0; k < n; ++k) {
+      lanePar[k] = p[k * kFitLanes + l];
+    }
+    for (size_t i = 0; i < m; ++i) {
+      const double wi = w[i * kFitLanes + l];
+      const double f = evalModel(model, absoluteValue, x[i], lanePar, grad);
+      r[i * kFitLanes + l] = (wi != 0.) ? (f - y[i * kFitLanes + l]) * wi : 0.;
+      if (jacobian) {
+        for (int k = 0; k < n; ++k) {
+          J[(i * kMaxPar + k) * kFitLanes + l] = (wi != 0.) ? grad[k] * wi : 0.;
+        }
+      }
+    }
+  }
+}
+
+// exp: x = n ln2 + r with |r| <= ln2 / 2, Taylor series of exp(r) to r^13 (below 1e-17), times 2^n
+// log: x = 2^e m with sqrt(1/2) <= m < sqrt(2), log(m) = 2 atanh(s) with s = (m - 1) / (m + 1)
+static const double ln2Hi = 6.93147180369123816490e-01;
+static const double ln2Lo = 1.90821492927058770002e-10;
+static const double expCoef[14] = {1., 1., 1. / 2, 1. / 6, 1. / 24, 1. / 120, 1. / 720, 1. / 5040, 1. / 40320,
+                                   1. / 362880, 1. / 3628800, 1. / 39916800, 1. / 479001600, 1. / 6227020800.};
+static const double logCoef[11] = {1., 1. / 3, 1. / 5, 1. / 7, 1. / 9, 1. / 11, 1. / 13, 1. / 15, 1. / 17,
+                                   1. / 19, 1. / 21};
+static const double magicInt = 6755399441055744.;   // 1.5 2^52, int64 + its bits is a double
+
+/// 2^n for integral n in [-1022, 1023]
+__attribute__((target("avx2")))
+static inline __m256d pow2AVX2(__m256d n) {
+  __m256i n64 = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+  return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(n64, _mm256_set1_epi64x(1023)), 52));
+}
+
+__attribute__((target("avx2")))
+static inline __m256d expAVX2(__m256d x) {
+  __m256d xc = _mm256_min_pd(_mm256_max_pd(x, _mm256_set1_pd(-746.)), _mm256_set1_pd(710.));
+  __m256d n = _mm256_round_pd(_mm256_mul_pd(xc, _mm256_set1_pd(1.4426950408889634074)),
+                              _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256d r = _mm256_sub_pd(_mm256_sub_pd(xc, _mm256_mul_pd(n, _mm256_set1_pd(ln2Hi))),
+                            _mm256_mul_pd(n, _mm256_set1_pd(ln2Lo)));
+  __m256d poly = _mm256_set1_pd(expCoef[13]);
+  for (int k = 12; k >= 0; --k) {
+    poly = _mm256_add_pd(_mm256_mul_pd(poly, r), _mm256_set1_pd(expCoef[k]));
+  }
+  // 2^n in two factors so that both stay normal, the product over- or underflows like exp
+  __m256d n1 = _mm256_floor_pd(_mm256_mul_pd(n, _mm256_set1_pd(0.5)));
+  __m256d n2 = _mm256_sub_pd(n, n1);
+  poly = _mm256_mul_pd(_mm256_mul_pd(poly, pow2AVX2(n1)), pow2AVX2(n2));
+  return _mm256_blendv_pd(poly, x, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+}
+
+/// Natural log of positive normal numbers
+__attribute__((target("avx2")))
+static inline __m256d logAVX2(__m256d x) {
+  __m256i bits = _mm256_castpd_si256(x);
+  __m256i e = _mm256_sub_epi64(_mm256_srli_epi64(bits, 52), _mm256_set1_epi64x(1023));
+  __m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000fffffffffffffLL)),
+                                                  _mm256_castpd_si256(_mm256_set1_pd(1.))));
+  __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(1.41421356237309504880), _CMP_GT_OQ);
+  m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+  __m256d ed = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(e, _mm256_castpd_si256(_mm256_set1_pd(magicInt)))),
+                             _mm256_set1_pd(magicInt));
+  ed = _mm256_add_pd(ed, _mm256_and_pd(big, _mm256_set1_pd(1.)));
+
+  __m256d f = _mm256_sub_pd(m, _mm256_set1_pd(1.));
+  __m256d s = _mm256_div_pd(f, _mm256_add_pd(f, _mm256_set1_pd(2.)));
+  __m256d z = _mm256_mul_pd(s, s);
+  __m256d poly = _mm256_set1_pd(logCoef[10]);
+  for (int k = 9; k >= 1; --k) {
+    poly = _mm256_add_pd(_mm256_mul_pd(poly, z), _mm256_set1_pd(logCoef[k]));
+  }
+  __m256d s2 = _mm256_add_pd(s, s);
+  __m256d logm = _mm256_add_pd(s2, _mm256_mul_pd(s2, _mm256_mul_pd(z, poly)));
+  return _mm256_add_pd(_mm256_mul_pd(ed, _mm256_set1_pd(ln2Hi)),
+                       _mm256_add_pd(logm, _mm256_mul_pd(ed, _mm256_set1_pd(ln2Lo))));
+}
+
+/// r = (f - y) w and J = grad w where w != 0, zero elsewhere (also for a NaN model value)
+__attribute__((target("avx2")))
+static inline void storeLanesAVX2(size_t i, int lane, int n, __m256d f, const __m256d* grad, const double* y,
+                                  const double* w, bool jacobian, double* r, double* J) {
+  __m256d wi = _mm256_loadu_pd(&w[i * kFitLanes + lane]);
+  __m256d used = _mm256_cmp_pd(wi, _mm256_setzero_pd(), _CMP_NEQ_UQ);
+  __m256d ri = _mm256_mul_pd(_mm256_sub_pd(f, _mm256_loadu_pd(&y[i * kFitLanes + lane])), wi);
+  _mm256_storeu_pd(&r[i * kFitLanes + lane], _mm256_and_pd(used, ri));
+  if (jacobian) {
+    for (int k = 0; k < n; ++k) {
+      _mm256_storeu_pd(&J[(i * kMaxPar + k) * kFitLanes + lane], _mm256_and_pd(used, _mm256_mul_pd(grad[k], wi)));
+    }
+  }
+}
+
+__attribute__((target("avx2")))
+static void evalLanesAVX2(ProfileModel model, bool absoluteValue, const double* x, size_t m, const double* y,
+                          const double* w, const double* p, bool jacobian, unsigned laneMask,
+                          double* r, double* J) {
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d one = _mm256_set1_pd(1.);
+  const __m256d nan = _mm256_set1_pd(numeric_limits<double>::quiet_NaN());
+  const __m256d signBit = _mm256_set1_pd(-0.);
+
+  for (int lane = 0; lane < kFitLanes; lane += 4) {
+    if ( !((laneMask >> lane) & 0xf) ) {
+      continue;
+    }
+    __m256d grad[kMaxPar];
+    if (model == ProfileModel::GaisserHillas) {
+      const __m256d Nmax = _mm256_loadu_pd(&p[0 * kFitLanes + lane]);
+      const __m256d Xmax = _mm256_loadu_pd(&p[1 * kFitLanes + lane]);
+      const __m256d X0 = _mm256_loadu_pd(&p[2 * kFitLanes + lane]);
+      const __m256d lamb = _mm256_loadu_pd(&p[3 * kFitLanes + lane]);
+      const __m256d D = _mm256_sub_pd(Xmax, X0);
+      const __m256d power = _mm256_div_pd(D, lamb);
+      const __m256d invLambTerm = _mm256_div_pd(one, lamb);
+      const __m256d lamb2 = _mm256_mul_pd(lamb, lamb);
+      const __m256d zeroPower = _mm256_cmp_pd(power, zero, _CMP_GT_OQ);
+
+      for (size_t i = 0; i < m; ++i) {
+        const __m256d X = _mm256_set1_pd(x[i]);
+        const __m256d u = _mm256_sub_pd(X, X0);
+        const __m256d base = _mm256_div_pd(absoluteValue ? _mm256_andnot_pd(signBit, u) : u, D);
+        const __m256d valid = _mm256_cmp_pd(base, zero, _CMP_GT_OQ);
+        const __m256d atZero = _mm256_and_pd(_mm256_cmp_pd(base, zero, _CMP_EQ_OQ), zeroPower);
+        const __m256d lt = logAVX2(_mm256_blendv_pd(one, base, valid));
+        const __m256d XmaxX = _mm256_sub_pd(Xmax, X);
+        const __m256d e = expAVX2(_mm256_add_pd(_mm256_mul_pd(power, lt), _mm256_div_pd(XmaxX, lamb)));
+        __m256d f = _mm256_mul_pd(Nmax, e);
+        const __m256d ltLamb = _mm256_div_pd(lt, lamb);
+        grad[0] = e;
+        grad[1] = _mm256_div_pd(_mm256_mul_pd(f, lt), lamb);
+        grad[2] = _mm256_mul_pd(f, _mm256_sub_pd(_mm256_sub_pd(invLambTerm, ltLamb), _mm256_div_pd(D, _mm256_mul_pd(lamb, u))));
+        grad[3] = _mm256_div_pd(_mm256_mul_pd(_mm256_xor_pd(f, signBit),
+                                              _mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(D, lt), Xmax), X)), lamb2);
+        f = _mm256_blendv_pd(_mm256_andnot_pd(atZero, nan), f, valid);
+        for (int k = 0; k < 4; ++k) {
+          grad[k] = _mm256_and_pd(valid, grad[k]);
+        }
+        storeLanesAVX2(i, lane, 4, f, grad, y, w, jacobian, r, J);
+      }
+    } else {
+      const __m256d Xmax = _mm256_loadu_pd(&p[0 * kFitLanes + lane]);
+      const __m256d R = _mm256_loadu_pd(&p[1 * kFitLanes + lane]);
+      const __m256d L = _mm256_loadu_pd(&p[2 * kFitLanes + lane]);
+      const __m256d R2 = _mm256_mul_pd(R, R);
+      const __m256d R3 = _mm256_mul_pd(R2, R);
+      const __m256d LR = _mm256_mul_pd(L, R);
+      const __m256d L2 = _mm256_mul_pd(L, L);
+      const __m256d LR2 = _mm256_mul_pd(L, R2);
+      const __m256d L2R = _mm256_mul_pd(L2, R);
+      const __m256d nonZeroR = _mm256_cmp_pd(R, zero, _CMP_NEQ_UQ);
+
+      for (size_t i = 0; i < m; ++i) {
+        const __m256d X = _mm256_set1_pd(x[i]);
+        const __m256d z = _mm256_sub_pd(X, Xmax);
+        const __m256d v = _mm256_add_pd(one, _mm256_div_pd(_mm256_mul_pd(R, z), L));
+        const __m256d base = absoluteValue ? _mm256_andnot_pd(signBit, v) : v;
+        const __m256d valid = _mm256_cmp_pd(base, zero, _CMP_GT_OQ);
+        const __m256d atZero = _mm256_and_pd(_mm256_cmp_pd(base, zero, _CMP_EQ_OQ), nonZeroR);
+        const __m256d lv = logAVX2(_mm256_blendv_pd(one, base, valid));
+        __m256d f = expAVX2(_mm256_sub_pd(_mm256_div_pd(lv, R2), _mm256_div_pd(z, LR)));
+        grad[0] = _mm256_div_pd(_mm256_mul_pd(f, z), _mm256_mul_pd(L2, v));
+        grad[1] = _mm256_mul_pd(f, _mm256_add_pd(_mm256_add_pd(_mm256_div_pd(_mm256_mul_pd(_mm256_set1_pd(-2.), lv), R3),
+                                                               _mm256_div_pd(z, _mm256_mul_pd(LR2, v))),
+                                                 _mm256_div_pd(z, LR2)));
+        grad[2] = _mm256_mul_pd(_mm256_div_pd(_mm256_mul_pd(f, z), L2R), _mm256_sub_pd(one, _mm256_div_pd(one, v)));
+        f = _mm256_blendv_pd(_mm256_andnot_pd(atZero, nan), f, valid);
+        for (int k = 0; k < 3; ++k) {
+          grad[k] = _mm256_and_pd(valid, grad[k]);
+        }
+        storeLanesAVX2(i, lane, 3, f, grad, y, w, jacobian, r, J);
+      }
+    }
+  }
+}
+
+__attribute__((target("avx512f")))
+static inline __m512d expAVX512(__m512d x) {
+  __m512d xc = _mm512_min_pd(_mm512_max_pd(x, _mm512_set1_pd(-746.)), _mm512_set1_pd(710.));
+  __m512d n = _mm512_roundscale_pd(_mm512_mul_pd(xc, _mm512_set1_pd(1.4426950408889634074)),
+                                   _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m512d r = _mm512_sub_pd(_mm512_sub_pd(xc, _mm512_mul_pd(n, _mm512_set1_pd(ln2Hi))),
+                            _mm512_mul_pd(n, _mm512_set1_pd(ln2Lo)));
+  __m512d poly = _mm512_set1_pd(expCoef[13]);
+  for (int k = 12; k >= 0; --k) {
+    poly = _mm512_add_pd(_mm512_mul_pd(poly, r), _mm512_set1_pd(expCoef[k]));
+  }
+  // scalef over- and underflows like exp
+  poly = _mm512_scalef_pd(poly, n);
+  return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(x, x, _CMP_UNORD_Q), poly, x);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512d logAVX512(__m512d x) {
+  __m512i bits = _mm512_castpd_si512(x);
+  __m512i e = _mm512_sub_epi64(_mm512_srli_epi64(bits, 52), _mm512_set1_epi64(1023));
+  __m512d m = _mm512_castsi512_pd(_mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi64(0x000fffffffffffffLL)),
+                                                  _mm512_castpd_si512(_mm512_set1_pd(1.))));
+  __mmask8 big = _mm512_cmp_pd_mask(m, _mm512_set1_pd(1.41421356237309504880), _CMP_GT_OQ);
+  m = _mm512_mask_mul_pd(m, big, m, _mm512_set1_pd(0.5));
+  __m512d ed = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_add_epi64(e, _mm512_castpd_si512(_mm512_set1_pd(magicInt)))),
+                             _mm512_set1_pd(magicInt));
+  ed = _mm512_mask_add_pd(ed, big, ed, _mm512_set1_pd(1.));
+
+  __m512d f = _mm512_sub_pd(m, _mm512_set1_pd(1.));
+  __m512d s = _mm512_div_pd(f, _mm512_add_pd(f, _mm512_set1_pd(2.)));
+  __m512d z = _mm512_mul_pd(s, s);
+  __m512d poly = _mm512_set1_pd(logCoef[10]);
+  for (int k = 9; k >= 1; --k) {
+    poly = _mm512_add_pd(_mm512_mul_pd(poly, z), _mm512_set1_pd(logCoef[k]));
+  }
+  __m512d s2 = _mm512_add_pd(s, s);
+  __m512d logm = _mm512_add_pd(s2, _mm512_mul_pd(s2, _mm512_mul_pd(z, poly)));
+  return _mm512_add_pd(_mm512_mul_pd(ed, _mm512_set1_pd(ln2Hi)),
+                       _mm512_add_pd(logm, _mm512_mul_pd(ed, _mm512_set1_pd(ln2Lo))));
+}
+
+__attribute__((target("avx512f")))
+static inline void storeLanesAVX512(size_t i, int n, __m512d f, const __m512d* grad, const double* y,
+                                    const double* w, bool jacobian, double* r, double* J) {
+  __m512d wi = _mm512_loadu_pd(&w[i * kFitLanes]);
+  __mmask8 used = _mm512_cmp_pd_mask(wi, _mm512_setzero_pd(), _CMP_NEQ_UQ);
+  __m512d ri = _mm512_mul_pd(_mm512_sub_pd(f, _mm512_loadu_pd(&y[i * kFitLanes])), wi);
+  _mm512_storeu_pd(&r[i * kFitLanes], _mm512_maskz_mov_pd(used, ri));
+  if (jacobian) {
+    for (int k = 0; k < n; ++k) {
+      _mm512_storeu_pd(&J[(i * kMaxPar + k) * kFitLanes], _mm512_maskz_mov_pd(used, _mm512_mul_pd(grad[k], wi)));
+    }
+  }
+}
+
+__attribute__((target("avx512f")))
+static void evalLanesAVX512(ProfileModel model, bool absoluteValue, const double* x, size_t m, const double* y,
+                            const double* w, const double* p, bool jacobian, unsigned /*laneMask*/,
+                            double* r, double* J) {
+  const __m512d zero = _mm512_setzero_pd();
+  const __m512d one = _mm512_set1_pd(1.);
+  const __m512d nan = _mm512_set1_pd(numeric_limits<double>::quiet_NaN());
+  __m512d grad[kMaxPar];
+
+  if (model == ProfileModel::GaisserHillas) {
+    const __m512d Nmax = _mm512_loadu_pd(&p[0 * kFitLanes]);
+    const __m512d Xmax = _mm512_loadu_pd(&p[1 * kFitLanes]);
+    const __m512d X0 = _mm512_loadu_pd(&p[2 * kFitLanes]);
+    const __m512d lamb = _mm512_loadu_pd(&p[3 * kFitLanes]);
+    const __m512d D = _mm512_sub_pd(Xmax, X0);
+    const __m512d power = _mm512_div_pd(D, lamb);
+    const __m512d invLambTerm = _mm512_div_pd(one, lamb);
+    const __m512d lamb2 = _mm512_mul_pd(lamb, lamb);
+    const __mmask8 zeroPower = _mm512_cmp_pd_mask(power, zero, _CMP_GT_OQ);
+
+    for (size_t i = 0; i < m; ++i) {
+      const __m512d X = _mm512_set1_pd(x[i]);
+      const __m512d u = _mm512_sub_pd(X, X0);
+      const __m512d base = _mm512_div_pd(absoluteValue ? _mm512_abs_pd(u) : u, D);
+      const __mmask8 valid = _mm512_cmp_pd_mask(base, zero, _CMP_GT_OQ);
+      const __mmask8 atZero = _mm512_mask_cmp_pd_mask(zeroPower, base, zero, _CMP_EQ_OQ);
+      const __m512d lt = logAVX512(_mm512_mask_blend_pd(valid, one, base));
+      const __m512d XmaxX = _mm512_sub_pd(Xmax, X);
+      const __m512d e = expAVX512(_mm512_add_pd(_mm512_mul_pd(power, lt), _mm512_div_pd(XmaxX, lamb)));
+      __m512d f = _mm512_mul_pd(Nmax, e);
+      const __m512d ltLamb = _mm512_div_pd(lt, lamb);
+      grad[0] = e;
+      grad[1] = _mm512_div_pd(_mm512_mul_pd(f, lt), lamb);
+      grad[2] = _mm512_mul_pd(f, _mm512_sub_pd(_mm512_sub_pd(invLambTerm, ltLamb), _mm512_div_pd(D, _mm512_mul_pd(lamb, u))));
+      grad[3] = _mm512_div_pd(_mm512_mul_pd(_mm512_sub_pd(zero, f),
+                                            _mm512_sub_pd(_mm512_add_pd(_mm512_mul_pd(D, lt), Xmax), X)), lamb2);
+      f = _mm512_mask_blend_pd(valid, _mm512_mask_blend_pd(atZero, nan, zero), f);
+      for (int k = 0; k < 4; ++k) {
+        grad[k] = _mm512_maskz_mov_pd(valid, grad[k]);
+      }
+      storeLanesAVX512(i, 4, f, grad, y, w, jacobian, r, J);
+    }
+  } else {
+    const __m512d Xmax = _mm512_loadu_pd(&p[0 * kFitLanes]);
+    const __m512d R = _mm512_loadu_pd(&p[1 * kFitLanes]);
+    const __m512d L = _mm512_loadu_pd(&p[2 * kFitLanes]);
+    const __m512d R2 = _mm512_mul_pd(R, R);
+    const __m512d R3 = _mm512_mul_pd(R2, R);
+    const __m512d LR = _mm512_mul_pd(L, R);
+    const __m512d L2 = _mm512_mul_pd(L, L);
+    const __m512d LR2 = _mm512_mul_pd(L, R2);
+    const __m512d L2R = _mm512_mul_pd(L2, R);
+    const __mmask8 nonZeroR = _mm512_cmp_pd_mask(R, zero, _CMP_NEQ_UQ);
+
+    for (size_t i = 0; i < m; ++i) {
+      const __m512d X = _mm512_set1_pd(x[i]);
+      const __m512d z = _mm512_sub_pd(X, Xmax);
+      const __m512d v = _mm512_add_pd(one, _mm512_div_pd(_mm512_mul_pd(R, z), L));
+      const __m512d base = absoluteValue ? _mm512_abs_pd(v) : v;
+      const __mmask8 valid = _mm512_cmp_pd_mask(base, zero, _CMP_GT_OQ);
+      const __mmask8 atZero = _mm512_mask_cmp_pd_mask(nonZeroR, base, zero, _CMP_EQ_OQ);
+      const __m512d lv = logAVX512(_mm512_mask_blend_pd(valid, one, base));
+      __m512d f = expAVX512(_mm512_sub_pd(_mm512_div_pd(lv, R2), _mm512_div_pd(z, LR)));
+      grad[0] = _mm512_div_pd(_mm512_mul_pd(f, z), _mm512_mul_pd(L2, v));
+      grad[1] = _mm512_mul_pd(f, _mm512_add_pd(_mm512_add_pd(_mm512_div_pd(_mm512_mul_pd(_mm512_set1_pd(-2.), lv), R3),
+                                                             _mm512_div_pd(z, _mm512_mul_pd(LR2, v))),
+                                               _mm512_div_pd(z, LR2)));
+      grad[2] = _mm512_mul_pd(_mm512_div_pd(_mm512_mul_pd(f, z), L2R), _mm512_sub_pd(one, _mm512_div_pd(one, v)));
+      f = _mm512_mask_blend_pd(valid, _mm512_mask_blend_pd(atZero, nan, zero), f);
+      for (int k = 0; k < 3; ++k) {
+        grad[k] = _mm512_maskz_mov_pd(valid, grad[k]);
+      }
+      storeLanesAVX512(i, 3, f, grad, y, w, jacobian, r, J);
+    }
+  }
+}
+
+/// --------------------------------------------------------------------------------------------
+/// Runtime dispatch
+/// --------------------------------------------------------------------------------------------
+struct FitKernelChoice {
+  FitEvalFunction function;
+  const char* name;
+};
+
+static FitKernelChoice bestFitKernel() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return FitKernelChoice{evalLanesAVX512, "avx512"};
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return FitKernelChoice{evalLanesAVX2, "avx2"};
+  }
+  return FitKernelChoice{evalLanesScalar, "scalar"};
+}
+
+static FitKernelChoice& currentFitKernel() {
+  static FitKernelChoice kernel = bestFitKernel();
+  return kernel;
+}
+
+bool selectFitKernel(const std::string& name) {
+  __builtin_cpu_init();
+  if (name == "auto") {
+    currentFitKernel() = bestFitKernel();
+  } else if (name == "scalar") {
+    currentFitKernel() = FitKernelChoice{evalLanesScalar, "scalar"};
+  } else if (name == "avx2" && __builtin_cpu_supports("avx2")) {
+    currentFitKernel() = FitKernelChoice{evalLanesAVX2, "avx2"};
+  } else if (name == "avx512" && __builtin_cpu_supports("avx512f")) {
+    currentFitKernel() = FitKernelChoice{evalLanesAVX512, "avx512"};
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* fitKernelName() {
+  return currentFitKernel().name;
+}
+
+static double norm(int n, const double* v) {
+  double sum = 0.;
+  for (int k = 0; k < n; ++k) {
+    sum += v[k] * v[k];
+  }
+  return sqrt(sum);
+}
+
+static double norm(const vector<double>& v) {
+  return norm(v.size(), v.data());
+}
+
+/// Householder QR of the rows x n matrix a (row-major), R goes to the upper triangle of R (n x n,
+/// row-major) and the reflections are applied to b, the first n elements of b become Q^T b
+static void householderQR(int rows, int n, vector<double>& a, double* b, double* R) {
+  for (int k = 0; k < n; ++k) {
+    double alpha = 0.;
+    for (int i = k; i < rows; ++i) {
+      alpha += a[i * n + k] * a[i * n + k];
+    }
+    alpha = sqrt(alpha);
+    if (alpha > 0.) {
+      if (a[k * n + k] > 0.) {
+        alpha = -alpha;
+      }
+      // v = a_k - alpha e_k, stored in place, H = 1 - 2 v v^T / v^T v
+      a[k * n + k] -= alpha;
+      double vv = 0.;
+      for (int i = k; i < rows; ++i) {
+        vv += a[i * n + k] * a[i * n + k];
+      }
+      for (int c = k + 1; c < n; ++c) {
+        double dot = 0.;
+        for (int i = k; i < rows; ++i) {
+          dot += a[i * n + k] * a[i * n + c];
+        }
+        double s = 2. * dot / vv;
+        for (int i = k; i < rows; ++i) {
+          a[i * n + c] -= s * a[i * n + k];
+        }
+      }
+      double dot = 0.;
+      for (int i = k; i < rows; ++i) {
+        dot += a[i * n + k] * b[i];
+      }
+      double s = 2. * dot / vv;
+      for (int i = k; i < rows; ++i) {
+        b[i] -= s * a[i * n + k];
+      }
+    }
+    for (int c = 0; c < n; ++c) {
+      R[k * n + c] = (c < k) ? 0. : ((c == k) ? alpha : a[k * n + c]);
+    }
+  }
+}
+
+/// Least squares solution of [R; diag(d)] x = [qtb; 0] (MINPACK qrsolv), S is the triangular
+/// factor of the stacked matrix
+static void solveDamped(int n, const double* R, const double* d, const double* qtb, double* x, double* S) {
+  vector<double> a(2 * n * n, 0.);
+  double b[2 * kMaxPar] = {0.};
+  for (int i = 0; i < n; ++i) {
+    for (int k = 0; k < n; ++k) {
+      a[i * n + k] = R[i * n + k];
+    }
+    a[(n + i) * n + i] = d[i];
+    b[i] = qtb[i];
+  }
+  householderQR(2 * n, n, a, b, S);
+  for (int i = n - 1; i >= 0; --i) {
+    double sum = b[i];
+    for (int k = i + 1; k < n; ++k) {
+      sum -= S[i * n + k] * x[k];
+    }
+    x[i] = (S[i * n + i] != 0.) ? sum / S[i * n + i] : 0.;
+  }
+}
+
+/// Solves T^T y = v for the upper triangular T (forward substitution)
+static void solveTransposed(int n, const double* T, const double* v, double* y) {
+  for (int j = 0; j < n; ++j) {
+    double sum = v[j];
+    for (int i = 0; i < j; ++i) {
+      sum -= T[i * n + j] * y[i];
+    }
+    y[j] = sum / T[j * n + j];
+  }
+}
+
+/// MINPACK lmpar: the Levenberg-Marquardt parameter par for which the scaled step |D x| is
+/// within 10% of delta, x is the step with J x ~ r
+static void levenbergParameter(int n, const double* R, const double* diag, const double* qtb, double delta,
+                               double& par, double* x) {
+  const double dwarf = numeric_limits<double>::min();
+  double wa1[kMaxPar], wa2[kMaxPar], S[kMaxPar * kMaxPar];
+
+  // Gauss-Newton direction, zero from the first singular column on
+  int nsing = n;
+  for (int j = 0; j < n; ++j) {
+    wa1[j] = qtb[j];
+    if (R[j * n + j] == 0. && nsing == n) {
+      nsing = j;
+    }
+    if (nsing < n) {
+      wa1[j] = 0.;
+    }
+  }
+  for (int j = nsing - 1; j >= 0; --j) {
+    wa1[j] /= R[j * n + j];
+    for (int i = 0; i < j; ++i) {
+      wa1[i] -= R[i * n + j] * wa1[j];
+    }
+  }
+  for (int j = 0; j < n; ++j) {
+    x[j] = wa1[j];
+    wa2[j] = diag[j] * x[j];
+  }
+  double dxnorm = norm(n, wa2);
+  double fp = dxnorm - delta;
+  if (fp <= 0.1 * delta) {
+    par = 0.;
+    return;
+  }
+
+  // Lower bound from the Newton step (full rank only) and upper bound from the gradient
+  double parl = 0.;
+  if (nsing == n) {
+    for (int j = 0; j < n; ++j) {
+      wa1[j] = diag[j] * (wa2[j] / dxnorm);
+    }
+    double y[kMaxPar];
+    solveTransposed(n, R, wa1, y);
+    double temp = norm(n, y);
+    parl = ((fp / delta) / temp) / temp;
+  }
+  for (int j = 0; j < n; ++j) {
+    double sum = 0.;
+    for (int i = 0; i <= j; ++i) {
+      sum += R[i * n + j] * qtb[i];
+    }
+    wa1[j] = sum / diag[j];
+  }
+  double gnorm = norm(n, wa1);
+  double paru = gnorm / delta;
+  if (paru == 0.) {
+    paru = dwarf / min(delta, 0.1);
+  }
+  par = max(par, parl);
+  par = min(par, paru);
+  if (par == 0.) {
+    par = gnorm / dxnorm;
+  }
+
+  for (int iter = 1; ; ++iter) {
+    if (par == 0.) {
+      par = max(dwarf, 0.001 * paru);
+    }
+    double d[kMaxPar];
+    for (int j = 0; j < n; ++j) {
+      d[j] = sqrt(par) * diag[j];
+    }
+    solveDamped(n, R, d, qtb, x, S);
+    for (int j = 0; j < n; ++j) {
+      wa2[j] = diag[j] * x[j];
+    }
+    dxnorm = norm(n, wa2);
+    double temp = fp;
+    fp = dxnorm - delta;
+    if (fabs(fp) <= 0.1 * delta || (parl == 0. && fp <= temp && temp < 0.) || iter == 10) {
+      return;
+    }
+
+    // Newton correction of par
+    for (int j = 0; j < n; ++j) {
+      wa1[j] = diag[j] * (wa2[j] / dxnorm);
+    }
+    double y[kMaxPar];
+    solveTransposed(n, S, wa1, y);
+    temp = norm(n, y);
+    double parc = ((fp / delta) / temp) / temp;
+    if (fp > 0.) {
+      parl = max(parl, par);
+    }
+    if (fp < 0.) {
+      paru = min(paru, par);
+    }
+    par = max(parl, par + parc);
+  }
+}
+
+/// --------------------------------------------------------------------------------------------
+/// Levenberg-Marquardt iterations
+/// --------------------------------------------------------------------------------------------
+/// The trust region scheme of MINPACK lmder (used by scipy's leastsq/curve_fit): automatic
+/// scaling by the Jacobian column norms, initial region 100 |D p|, the ftol/xtol tests and a
+/// budget of 200 (n + 1) evaluations where a Jacobian counts n, as for the finite differences of
+/// curve_fit. The QR factorization is done without column pivoting, n is at most 4.
+///
+/// Every lane of a batch runs the iterations of one fit. lmder is cut where it needs the model:
+/// a lane waits either for a Jacobian at p or for the residuals at the trial point, the batch
+/// evaluates all lanes together and each lane continues from its own stage.
+enum class LaneStage {Start, NeedJacobian, NeedTrial, Converged, Failed};
+
+struct LMLane {
+  LaneStage stage = LaneStage::Failed;
+  vector<size_t> rows;   // points of the grid used by this fit
+  vector<double> fvec, qtf, J;
+  double p[kMaxPar], pTrial[kMaxPar], step[kMaxPar], diag[kMaxPar], R[kMaxPar * kMaxPar];
+  double delta = 0., lmPar = 0., xnorm = 0., fnorm = 0., gnorm = 0., pnorm = 0.;
+  int iter = 1;
+  int nfev = 0;
+};
+
+/// Residuals of the lane out of the batch layout
+static void gatherResiduals(const LMLane& lane, int l, const vector<double>& r, vector<double>& fvec) {
+  for (size_t j = 0; j < lane.rows.size(); ++j) {
+    fvec[j] = r[lane.rows[j] * kFitLanes + l];
+  }
+}
+
+/// Next trial point from the trust region
+static void proposeStep(LMLane& lane, int n) {
+  levenbergParameter(n, lane.R, lane.diag, lane.qtf.data(), lane.delta, lane.lmPar, lane.step);
+  double scaled[kMaxPar];
+  for (int k = 0; k < n; ++k) {
+    lane.step[k] = -lane.step[k];
+    lane.pTrial[k] = lane.p[k] + lane.step[k];
+    scaled[k] = lane.diag[k] * lane.step[k];
+  }
+  lane.pnorm = norm(n, scaled);
+  if (lane.iter == 1) {
+    lane.delta = min(lane.delta, lane.pnorm);
+  }
+  lane.stage = LaneStage::NeedTrial;
+}
+
+/// Jacobian at p: QR, scaling, gradient test and the first trial step
+static void afterJacobian(LMLane& lane, int l, int n, const vector<double>& r, const vector<double>& J) {
+  const size_t m = lane.rows.size();
+  lane.nfev += n;
+  gatherResiduals(lane, l, r, lane.fvec);
+  for (size_t j = 0; j < m; ++j) {
+    for (int k = 0; k < n; ++k) {
+      lane.J[j * n + k] = J[(lane.rows[j] * kMaxPar + k) * kFitLanes + l];
+    }
+  }
+
+  double acnorm[kMaxPar];
+  for (int k = 0; k < n; ++k) {
+    double sum = 0.;
+    for (size_t i = 0; i < m; ++i) {
+      sum += lane.J[i * n + k] * lane.J[i * n + k];
+    }
+    acnorm[k] = sqrt(sum);
+  }
+  lane.qtf = lane.fvec;
+  householderQR(m, n, lane.J, lane.qtf.data(), lane.R);
+
+  if (lane.iter == 1) {
+    for (int k = 0; k < n; ++k) {
+      lane.diag[k] = (acnorm[k] == 0.) ? 1. : acnorm[k];
+      lane.pTrial[k] = lane.diag[k] * lane.p[k];
+    }
+    lane.xnorm = norm(n, lane.pTrial);
+    lane.delta = (lane.xnorm == 0.) ? 100. : 100. * lane.xnorm;
+  }
+
+  // Scaled gradient, zero at an exact minimum
+  lane.gnorm = 0.;
+  if (lane.fnorm != 0.) {
+    for (int j = 0; j < n; ++j) {
+      if (acnorm[j] != 0.) {
+        double sum = 0.;
+        for (int i = 0; i <= j; ++i) {
+          sum += lane.R[i * n + j] * (lane.qtf[i] / lane.fnorm);
+        }
+        lane.gnorm = max(lane.gnorm, fabs(sum / acnorm[j]));
+      }
+    }
+  }
+  if (lane.gnorm <= 0.) {
+    lane.stage = LaneStage::Converged;
+    return;
+  }
+
+  for (int k = 0; k < n; ++k) {
+    lane.diag[k] = max(lane.diag[k], acnorm[k]);
+  }
+  proposeStep(lane, n);
+}
+
+/// Residuals at the trial point: acceptance, trust region update and the convergence tests
+static void afterTrial(LMLane& lane, int l, int n, const vector<double>& r, vector<double>& fTrial) {
+  const double epsmch = numeric_limits<double>::epsilon();
+  const int maxfev = 200 * (n + 1);
+
+  fTrial.resize(lane.rows.size());
+  gatherResiduals(lane, l, r, fTrial);
+  lane.nfev += 1;
+  double fnorm1 = norm(fTrial);
+
+  // Actual and predicted relative reductions, a NaN model value gives actred = -1
+  double actred = -1.;
+  if (0.1 * fnorm1 < lane.fnorm) {
+    actred = 1. - (fnorm1 / lane.fnorm) * (fnorm1 / lane.fnorm);
+  }
+  double wa3[kMaxPar];
+  for (int i = 0; i < n; ++i) {
+    wa3[i] = 0.;
+    for (int j = i; j < n; ++j) {
+      wa3[i] += lane.R[i * n + j] * lane.step[j];
+    }
+  }
+  double temp1 = norm(n, wa3) / lane.fnorm;
+  double temp2 = sqrt(lane.lmPar) * lane.pnorm / lane.fnorm;
+  double prered = temp1 * temp1 + temp2 * temp2 / 0.5;
+  double dirder = -(temp1 * temp1 + temp2 * temp2);
+  double ratio = (prered != 0.) ? actred / prered : 0.;
+
+  // Update of the trust region
+  if (ratio <= 0.25) {
+    double temp = (actred >= 0.) ? 0.5 : 0.5 * dirder / (dirder + 0.5 * actred);
+    if (0.1 * fnorm1 >= lane.fnorm || temp < 0.1) {
+      temp = 0.1;
+    }
+    lane.delta = temp * min(lane.delta, lane.pnorm / 0.1);
+    lane.lmPar /= temp;
+  } else if (lane.lmPar == 0. || ratio >= 0.75) {
+    lane.delta = lane.pnorm / 0.5;
+    lane.lmPar *= 0.5;
+  }
+
+  const bool accepted = (ratio >= 1.e-4);
+  if (accepted) {
+    double scaled[kMaxPar];
+    copy(lane.pTrial, lane.pTrial + n, lane.p);
+    lane.fvec.swap(fTrial);
+    for (int k = 0; k < n; ++k) {
+      scaled[k] = lane.diag[k] * lane.p[k];
+    }
+    lane.xnorm = norm(n, scaled);
+    lane.fnorm = fnorm1;
+    lane.iter += 1;
+  }
+
+  // Convergence (ftol, xtol), then the budget and the tolerances below machine precision
+  if ((fabs(actred) <= kTolerance && prered <= kTolerance && 0.5 * ratio <= 1.) || lane.delta <= kTolerance * lane.xnorm) {
+    lane.stage = LaneStage::Converged;
+  } else if (lane.nfev >= maxfev || (fabs(actred) <= epsmch && prered <= epsmch && 0.5 * ratio <= 1.)
+             || lane.delta <= epsmch * lane.xnorm || lane.gnorm <= epsmch) {
+    lane.stage = LaneStage::Failed;
+  } else if (accepted) {
+    lane.stage = LaneStage::NeedJacobian;
+  } else {
+    proposeStep(lane, n);
+  }
+}
+
+/// pcov = inv(R^T R) * chi2 / (m - n) with R of the last Jacobian, as leastsq does
+static void laneSigmas(const LMLane& lane, int n, double* parSigma) {
+  const size_t m = lane.rows.size();
+  fill(parSigma, parSigma + n, numeric_limits<double>::infinity());
+  if ((int) m <= n) {
+    return;
+  }
+  const double scale = lane.fnorm * lane.fnorm / (m - n);
+  for (int k = 0; k < n; ++k) {
+    if ( !(fabs(lane.R[k * n + k]) > 0.) ) {
+      return;
+    }
+  }
+  // inv(R^T R) = inv(R) inv(R)^T, the diagonal is the squared norm of the rows of inv(R)
+  for (int k = 0; k < n; ++k) {
+    double e[kMaxPar] = {0.}, row[kMaxPar];
+    e[k] = 1.;
+    solveTransposed(n, lane.R, e, row);   // row = k-th column of inv(R)^T = k-th row of inv(R)
+    double variance = 0.;
+    for (int j = 0; j < n; ++j) {
+      variance += row[j] * row[j];
+    }
+    parSigma[k] = sqrt(variance * scale);
+  }
+}
+
+void fitProfileBatch(ProfileModel model, bool absoluteValue, const vector<double>& x, size_t nFits,
+                     const vector<double>& y, const vector<double>& sigma,
+                     vector<double>& par, vector<double>& parSigma, vector<char>& ok) {
+  const int n = numParameters(model);
+  const size_t m = x.size();
+  const FitEvalFunction evaluate = currentFitKernel().function;
+  parSigma.resize(nFits * n);
+  ok.assign(nFits, 0);
+
+  vector<double> yLanes(m * kFitLanes), wLanes(m * kFitLanes), pLanes(kMaxPar * kFitLanes);
+  vector<double> r(m * kFitLanes), J(m * kMaxPar * kFitLanes), fTrial;
+  LMLane lanes[kFitLanes];
+
+  for (size_t first = 0; first < nFits; first += kFitLanes) {
+    const int nLanes = (int) min<size_t>(kFitLanes, nFits - first);
+
+    // Transpose the chunk into the lanes, unused lanes get no points and the values of lane 0
+    for (int l = 0; l < kFitLanes; ++l) {
+      LMLane& lane = lanes[l];
+      const size_t fit = first + ((l < nLanes) ? l : 0);
+      lane = LMLane();
+      for (size_t i = 0; i < m; ++i) {
+        const double w = (l < nLanes) ? 1. / sigma[fit * m + i] : 0.;
+        yLanes[i * kFitLanes + l] = y[fit * m + i];
+        wLanes[i * kFitLanes + l] = w;
+        if (w != 0.) {
+          lane.rows.push_back(i);
+        }
+      }
+      copy(&par[fit * n], &par[fit * n] + n, lane.p);
+      // fewer points than parameters is improper input for MINPACK as well
+      if (l < nLanes && lane.rows.size() >= (size_t) n) {
+        lane.stage = LaneStage::Start;
+        lane.fvec.resize(lane.rows.size());
+        lane.J.resize(lane.rows.size() * n);
+      }
+    }
+
+    for (;;) {
+      unsigned laneMask = 0;
+      bool jacobian = false;
+      for (int l = 0; l < kFitLanes; ++l) {
+        const LMLane& lane = lanes[l];
+        if (lane.stage == LaneStage::Start || lane.stage == LaneStage::NeedJacobian || lane.stage == LaneStage::NeedTrial) {
+          laneMask |= 1u << l;
+        }
+        jacobian |= (lane.stage == LaneStage::NeedJacobian);
+        const double* p = (lane.stage == LaneStage::NeedTrial) ? lane.pTrial : lane.p;
+        for (int k = 0; k < n; ++k) {
+          pLanes[k * kFitLanes + l] = p[k];
+        }
+      }
+      if (laneMask == 0) {
+        break;
+      }
+
+      evaluate(model, absoluteValue, x.data(), m, yLanes.data(), wLanes.data(), pLanes.data(), jacobian, laneMask,
+               r.data(), J.data());
+
+      for (int l = 0; l < nLanes; ++l) {
+        LMLane& lane = lanes[l];
+        if (lane.stage == LaneStage::Start) {
+          lane.nfev = 1;
+          gatherResiduals(lane, l, r, lane.fvec);
+          lane.fnorm = norm(lane.fvec);
+          lane.stage = isfinite(lane.fnorm) ? LaneStage::NeedJacobian : LaneStage::Failed;
+        } else if (lane.stage == LaneStage::NeedJacobian) {
+          afterJacobian(lane, l, n, r, J);
+        } else if (lane.stage == LaneStage::NeedTrial) {
+          afterTrial(lane, l, n, r, fTrial);
+        }
+      }
+    }
+
+    for (int l = 0; l < nLanes; ++l) {
+      const size_t fit = first + l;
+      if (lanes[l].stage == LaneStage::Converged) {
+        ok[fit] = 1;
+        copy(lanes[l].p, lanes[l].p + n, &par[fit * n]);
+        laneSigmas(lanes[l], n, &parSigma[fit * n]);
+      }
+    }
+  }
+}
+
+bool fitProfile(ProfileModel model, bool absoluteValue, const vector<double>& x, const vector<double>& y,
+                const vector<double>& sigma, vector<double>& par, vector<double>& parSigma) {
+  const int n = numParameters(model);
+  if ((int) par.size() != n || y.size() != x.size() || sigma.size() != x.size()) {
+    return false;
+  }
+  vector<double> p = par, err;
+  vector<char> ok;
+  fitProfileBatch(model, absoluteValue, x, 1, y, sigma, p, err, ok);
+  if (!ok[0]) {
+    return false;
+  }
+  par = p;
+  parSigma = err;
+  return true;
+}
+
+
+/// --------------------------------------------------------------------------------------------
+/// The fits of ParseAndFitLongitudinalProfile_Auger.py
+/// --------------------------------------------------------------------------------------------
+static ProfileFit failedFit() {
+  const double inf = numeric_limits<double>::infinity();
+  ProfileFit fit = {inf, inf, inf, inf, inf, inf};
+  return fit;
+}
+
+/// Depths moved by the shift, the particle numbers and their uncertainties 1 / sqrt(N) in rows of the batch
+static double batchInput(const vector<double>& depths, const vector<ProfileFitJob>& jobs, bool shift, bool absoluteValue,
+                         vector<double>& x, vector<double>& y, vector<double>& uncerts) {
+  const double offset = (shift && !absoluteValue) ? 100. : 0.;
+  const size_t m = depths.size();
+  x.resize(m);
+  for (size_t i = 0; i < m; ++i) {
+    x[i] = depths[i] + offset;
+  }
+  y.resize(jobs.size() * m);
+  uncerts.resize(jobs.size() * m);
+  for (size_t k = 0; k < jobs.size(); ++k) {
+    for (size_t i = 0; i < m; ++i) {
+      const double N = jobs[k].particles[i];
+      y[k * m + i] = N;
+      // Poissonian-like relative uncertainty, only used to weight the fit towards Xmax
+      uncerts[k * m + i] = (N != 0.) ? 1. / sqrt(N) : numeric_limits<double>::infinity();
+    }
+  }
+  return offset;
+}
+
+vector<ProfileFit> fitGaisserHillasBatch(const vector<double>& depths, const vector<ProfileFitJob>& jobs,
+                                         bool shift, bool absoluteValue) {
+  vector<double> x, y, uncerts, par(jobs.size() * 4), err;
+  vector<char> ok;
+  const double offset = batchInput(depths, jobs, shift, absoluteValue, x, y, uncerts);
+  for (size_t k = 0; k < jobs.size(); ++k) {
+    const vector<double>& start = jobs[k].start;
+    par[k * 4 + 0] = start[0];
+    par[k * 4 + 1] = start[1] + offset;
+    par[k * 4 + 2] = start[2];
+    par[k * 4 + 3] = start[3];
+  }
+  fitProfileBatch(ProfileModel::GaisserHillas, absoluteValue && !shift, x, jobs.size(), y, uncerts, par, err, ok);
+
+  vector<ProfileFit> fits(jobs.size(), failedFit());
+  for (size_t k = 0; k < jobs.size(); ++k) {
+    if (!ok[k]) {
+      continue;
+    }
+    const double XmaxFit = par[k * 4 + 1], X0Fit = par[k * 4 + 2], lambFit = par[k * 4 + 3];
+    const double XmaxSigma = err[k * 4 + 1], X0Sigma = err[k * 4 + 2], lambSigma = err[k * 4 + 3];
+    const double X0Prime = fabs(X0Fit - XmaxFit);
+
+    ProfileFit& fit = fits[k];
+    fit.R = sqrt(lambFit / X0Prime);
+    fit.L = sqrt(X0Prime * lambFit);
+    // Squared terms found from error prop.
+    fit.RSigma = sqrt(lambSigma * lambSigma / (4 * lambFit * X0Prime)
+                      + lambFit * (X0Sigma * X0Sigma + XmaxSigma * XmaxSigma) / (4 * X0Prime * X0Prime * X0Prime));
+    fit.LSigma = sqrt(X0Prime * lambSigma * lambSigma / (4 * lambFit)
+                      + lambFit * (X0Sigma * X0Sigma + XmaxSigma * XmaxSigma) / (4 * X0Prime));
+    fit.Xmax = XmaxFit - offset;   // shift Xmax from fit back to real xmax
+    fit.XmaxSigma = XmaxSigma;
+  }
+  return fits;
+}
+
+vector<ProfileFit> fitAndringaBatch(const vector<double>& depths, const vector<ProfileFitJob>& jobs,
+                                    bool shift, bool absoluteValue) {
+  vector<double> x, y, uncerts, par(jobs.size() * 3), err;
+  vector<char> ok;
+  const double offset = batchInput(depths, jobs, shift, absoluteValue, x, y, uncerts);
+  for (size_t k = 0; k < jobs.size(); ++k) {
+    const vector<double>& start = jobs[k].start;
+    par[k * 3 + 0] = start[0] + offset;
+    par[k * 3 + 1] = start[1];
+    par[k * 3 + 2] = start[2];
+  }
+  fitProfileBatch(ProfileModel::Andringa, absoluteValue && !shift, x, jobs.size(), y, uncerts, par, err, ok);
+
+  vector<ProfileFit> fits(jobs.size(), failedFit());
+  for (size_t k = 0; k < jobs.size(); ++k) {
+    if (!ok[k]) {
+      continue;
+    }
+    ProfileFit& fit = fits[k];
+    fit.Xmax = par[k * 3 + 0] - offset;
+    fit.XmaxSigma = err[k * 3 + 0];
+    fit.R = par[k * 3 + 1];
+    fit.RSigma = err[k * 3 + 1];
+    fit.L = par[k * 3 + 2];
+    fit.LSigma = err[k * 3 + 2];
+  }
+  return fits;
+}
+
+ProfileFit fitGaisserHillas(const vector<double>& depths, const vector<double>& particles,
+                            double NmaxGuess, double XmaxGuess, double X0Guess, double lambGuess,
+                            bool shift, bool absoluteValue) {
+  ProfileFitJob job = {particles, {NmaxGuess, XmaxGuess, X0Guess, lambGuess}};
+  return fitGaisserHillasBatch(depths, vector<ProfileFitJob>(1, job), shift, absoluteValue)[0];
+}
+
+ProfileFit fitAndringa(const vector<double>& depths, const vector<double>& nPrime,
+                       double XmaxGuess, double RGuess, double LGuess, bool shift, bool absoluteValue) {
+  ProfileFitJob job = {nPrime, {XmaxGuess, RGuess, LGuess}};
+  return fitAndringaBatch(depths, vector<ProfileFitJob>(1, job), shift, absoluteValue)[0];
+}
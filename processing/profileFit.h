@@ -0,0 +1,77 @@
+#ifndef PROFILEFIT_H
+#define PROFILEFIT_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/// --------------------------------------------------------------------------------------------
+/// Levenberg-Marquardt fits of the longitudinal profiles
+/// --------------------------------------------------------------------------------------------
+/// Native replacement of the scipy curve_fit calls of ParseAndFitLongitudinalProfile_Auger.py.
+/// The residuals are (f(X) - N) / sigma, the covariance is inv(J^T J) scaled by chi2 / (n - p)
+/// like curve_fit with absolute_sigma=False. The Jacobians are analytic.
+///
+///   Gaisser-Hillas  N(X) = Nmax ((X - X0) / (Xmax - X0))^((Xmax - X0) / lambda) exp((Xmax - X) / lambda)
+///   Andringa        N'(X) = (1 + R (X - Xmax) / L)^(1 / R^2) exp(-(X - Xmax) / (L R))
+///
+/// With absoluteValue the base of the power is taken as |...|, otherwise a negative base makes
+/// the model NaN and such a step is rejected.
+///
+/// Fits on the same depth grid run in batches of kFitLanes: the model and its Jacobian are
+/// evaluated for all lanes at once (scalar, AVX2 or AVX-512 kernel), every lane keeps its own
+/// iteration state and drops out when it has converged or failed.
+enum class ProfileModel {GaisserHillas, Andringa};
+
+const int kFitLanes = 8;
+
+/// Fits the parameters (Nmax, Xmax, X0, lambda) or (Xmax, R, L) starting from par. Returns false
+/// when no minimum is found within the evaluation budget (curve_fit raises RuntimeError), par and
+/// parSigma are then untouched. A sigma is inf when the covariance cannot be estimated.
+bool fitProfile(ProfileModel model, bool absoluteValue, const std::vector<double>& x, const std::vector<double>& y,
+                const std::vector<double>& sigma, std::vector<double>& par, std::vector<double>& parSigma);
+
+/// nFits fits on the grid x: y and sigma hold nFits rows of x.size() values, points with an
+/// infinite sigma are left out of their fit. par (nFits rows of the start values) and parSigma
+/// are updated for the fits with ok[k] set.
+void fitProfileBatch(ProfileModel model, bool absoluteValue, const std::vector<double>& x, size_t nFits,
+                     const std::vector<double>& y, const std::vector<double>& sigma,
+                     std::vector<double>& par, std::vector<double>& parSigma, std::vector<char>& ok);
+
+/// Selects the evaluation kernel ("scalar", "avx2", "avx512" or "auto"), false if not available here
+bool selectFitKernel(const std::string& name);
+const char* fitKernelName();
+
+/// Shape values of one fit, every field is inf if the fit failed (the np.inf convention)
+struct ProfileFit {
+  double R;
+  double RSigma;
+  double L;
+  double LSigma;
+  double Xmax;
+  double XmaxSigma;
+};
+
+/// One profile of a batch: the particle numbers at every depth of the batch (0 leaves the depth
+/// out) and the start values (NmaxGuess, XmaxGuess, X0Guess, lambGuess) or (XmaxGuess, RGuess, LGuess)
+struct ProfileFitJob {
+  std::vector<double> particles;
+  std::vector<double> start;
+};
+
+/// FitLongitudinalProfile: Gaisser-Hillas fit converted to R = sqrt(lambda / |X0 - Xmax|) and
+/// L = sqrt(|X0 - Xmax| lambda). With shift (and not absoluteValue) the depths are moved by
+/// +100 g/cm2 for the fit, which is more robust against large X0 values.
+ProfileFit fitGaisserHillas(const std::vector<double>& depths, const std::vector<double>& particles,
+                            double NmaxGuess, double XmaxGuess, double X0Guess, double lambGuess,
+                            bool shift, bool absoluteValue);
+std::vector<ProfileFit> fitGaisserHillasBatch(const std::vector<double>& depths, const std::vector<ProfileFitJob>& jobs,
+                                              bool shift, bool absoluteValue);
+
+/// FitLongitudinalProfileAndringa: Andringa fit of the normalized profile N' = N / Nmax
+ProfileFit fitAndringa(const std::vector<double>& depths, const std::vector<double>& nPrime,
+                       double XmaxGuess, double RGuess, double LGuess, bool shift, bool absoluteValue);
+std::vector<ProfileFit> fitAndringaBatch(const std::vector<double>& depths, const std::vector<ProfileFitJob>& jobs,
+                                         bool shift, bool absoluteValue);
+
+#endif
@@ -0,0 +1,30 @@
+#include "radialBins.h"
+
+RadialBins::RadialBins(int nBins, double binWidth) {
+  width = binWidth;
+  invWidth = 1. / binWidth;
+  rangeMax = nBins * binWidth;
+  binContent = std::vector<double> (nBins, 0.);
+}
+
+void RadialBins::Merge(const RadialBins& other) {
+  for (size_t b = 0; b < binContent.size() && b < other.binContent.size(); b++) {
+    binContent[b] += other.binContent[b];
+  }
+}
+
+void RadialBins::Clear() {
+  for (size_t b = 0; b < binContent.size(); b++) {
+    binContent[b] = 0.;
+  }
+}
+
+std::vector<double> RadialBins::Cumulative() const {
+  std::vector<double> cumulative(binContent.size(), 0.);
+  double sum = 0.;
+  for (size_t b = 0; b < binContent.size(); b++) {
+    sum += binContent[b];
+    cumulative[b] = sum;
+  }
+  return cumulative;
+}
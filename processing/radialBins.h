@@ -0,0 +1,57 @@
+#ifndef RADIALBINS_H
+#define RADIALBINS_H
+
+#include <vector>
+#include <cstddef>
+
+/// --------------------------------------------------------------------------------------------
+/// Radial binning of the particle counts
+/// --------------------------------------------------------------------------------------------
+/// Bin k holds the summed weights of the particles with k * width < dist <= (k + 1) * width
+/// (bin 0 includes dist == 0), particles beyond nBins * width are not kept. Each particle costs one
+/// index computation, the cumulative nX<Rm columns are the prefix sums of the bins.
+class RadialBins {
+  double width = 50.;
+  double invWidth = 1. / 50.;
+  double rangeMax = 1000.;
+  std::vector<double> binContent;
+public:
+  RadialBins(int nBins = 20, double binWidth = 50.);
+
+  void Fill(double dist, double w) {
+    if ( !(dist <= rangeMax) ) {
+      return; // beyond the last bin (or NaN)
+    }
+    int bin = (int) (dist * invWidth);
+    // dist * invWidth can round across a bin edge, the edges themselves decide
+    if (bin > 0 && dist <= bin * width) {
+      bin -= 1;
+    } else if (dist > (bin + 1) * width) {
+      bin += 1;
+    }
+    if (bin >= (int) binContent.size()) {
+      bin = binContent.size() - 1;
+    }
+    binContent[bin] += w;
+  };
+
+  void Merge(const RadialBins& other);
+  void Clear();
+
+  /// Raw bin contents, for checkpoints
+  void Save(std::vector<double>& state) const { state.insert(state.end(), binContent.begin(), binContent.end()); };
+  void Load(const double*& state) {
+    for (size_t b = 0; b < binContent.size(); b++) {
+      binContent[b] = *state++;
+    }
+  };
+
+  int NumBins() const { return binContent.size(); };
+  double Width() const { return width; };
+  double UpperEdge(int bin) const { return (bin + 1) * width; };
+
+  /// Element k is the sum of bins 0..k, i.e. the particles with dist <= (k + 1) * width
+  std::vector<double> Cumulative() const;
+};
+
+#endif
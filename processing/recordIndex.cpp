@@ -0,0 +1,112 @@
+#include "recordIndex.h"
+#include "recordLayout.h"
+#include "columnFile.h"
+#include "batchRunner.h"
+
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+using namespace std;
+
+vector<size_t> RecordIndex::EventHeaders() const {
+  vector<size_t> headers;
+  for (size_t k = 0; k < entries.size(); ++k) {
+    if (entries[k].tag == EventHeaderTag) {
+      headers.push_back(k);
+    }
+  }
+  return headers;
+}
+
+string indexNameOf(const string& datFile) {
+  return datFile + ".index";
+}
+
+/// Size and modification time (in ns) of the DAT file, the index is only valid for exactly this file
+static bool sourceStamp(const string& datFile, string& size, string& mtime) {
+  uint64_t bytes;
+  int64_t ns;
+  if (!fileStamp(datFile, bytes, ns)) {
+    return false;
+  }
+  size = to_string((unsigned long long) bytes);
+  mtime = to_string((long long) ns);
+  return true;
+}
+
+bool writeRecordIndex(const string& datFile, int recordBytes, int subBlockWords, const RecordIndex& index) {
+  string size, mtime;
+  if (!sourceStamp(datFile, size, mtime)) {
+    return false;
+  }
+  vector<pair<string, string> > metadata = {
+    {"index", "corsika header sub-blocks"}, {"source_size", size}, {"source_mtime", mtime},
+    {"record_bytes", to_string(recordBytes)}, {"records", to_string(index.nRecords)},
+    {"broken", index.broken ? "yes" : "no"}, {"runh_showers", to_string(index.nrShow)},
+    {"evte", to_string(index.nEVTE)}};
+  vector<ColumnSpec> columns = {{"tag", ColumnType::Int32}, {"event", ColumnType::Int32},
+                                {"record", ColumnType::Float64}, {"block", ColumnType::Int32},
+                                {"offset", ColumnType::Float64}};
+
+  string indexName = indexNameOf(datFile);
+  string tempName = indexName + ".tmp";
+  {
+    ColumnWriter writer(tempName, columns, metadata);
+    int event = 0;
+    vector<double> row(columns.size());
+    for (const IndexEntry& entry : index.entries) {
+      event += (entry.tag == EventHeaderTag);
+      row[0] = entry.tag;
+      row[1] = event;
+      row[2] = entry.record;
+      row[3] = entry.block;
+      // after the leading record length word
+      row[4] = (double) entry.record * recordBytes + 4. * (1 + (double) entry.block * subBlockWords);
+      writer.AddRow(row);
+    }
+    if (!writer.Close()) {
+      remove(tempName.c_str());
+      return false;
+    }
+  }
+  return rename(tempName.c_str(), indexName.c_str()) == 0;
+}
+
+bool readRecordIndex(const string& datFile, int recordBytes, RecordIndex& index, string& error) {
+  string indexName = indexNameOf(datFile);
+  vector<ColumnSpec> columns;
+  vector<pair<string, string> > metadata;
+  vector<vector<double> > values;
+  if (!readColumnFile(indexName, columns, metadata, values, error)) {
+    return false;
+  }
+  if (columns.size() < 4 || columns[0].name != "tag" || columns[2].name != "record" || columns[3].name != "block") {
+    error = indexName + " is not a record index";
+    return false;
+  }
+
+  string size, mtime;
+  if (!sourceStamp(datFile, size, mtime)) {
+    error = "Cannot stat " + datFile;
+    return false;
+  }
+  map<string, string> meta(metadata.begin(), metadata.end());
+  if (meta["source_size"] != size || meta["source_mtime"] != mtime) {
+    error = indexName + " is out of date";
+    return false;
+  }
+  if (meta["record_bytes"] != to_string(recordBytes)) {
+    error = indexName + " is for the other simulation type";
+    return false;
+  }
+
+  index.Clear();
+  index.nRecords = strtoull(meta["records"].c_str(), nullptr, 10);
+  index.broken = meta["broken"] != "no";
+  index.nrShow = atoi(meta["runh_showers"].c_str());
+  index.nEVTE = atoi(meta["evte"].c_str());
+  for (size_t r = 0; r < values[0].size(); ++r) {
+    index.entries.push_back(IndexEntry{(uint32_t) values[0][r], (size_t) values[2][r], (int) values[3][r]});
+  }
+  return true;
+}
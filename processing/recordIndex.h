@@ -0,0 +1,51 @@
+#ifndef RECORDINDEX_H
+#define RECORDINDEX_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/// --------------------------------------------------------------------------------------------
+/// Index of the header sub-blocks of a DAT file (<DAT file>.index, --write-index)
+/// --------------------------------------------------------------------------------------------
+/// Position of every RUNH, EVTH, LONG, EVTE and RUNE sub-block as record and sub-block number, so a
+/// later pass can read the header of shower N or process only its records (EVTH record .. EVTE
+/// record) without reading the file up to it, and --per-event --threads can split the file on
+/// shower boundaries without scanning it first.
+///
+/// Stored as a column file (columnFile.h) with one row per header sub-block and the columns
+///   tag (the first word, see recordLayout.h), event (the shower it belongs to, counted from 1, 0
+///   before the first EVTH), record, block, offset (byte offset of the sub-block in the file)
+/// and the metadata source_size and source_mtime of the DAT file. An index whose DAT file has
+/// changed since is not used.
+struct IndexEntry {
+  uint32_t tag;
+  size_t record;
+  int block;
+};
+
+struct RecordIndex {
+  std::vector<IndexEntry> entries;   // in file order
+  size_t nRecords = 0;               // records processRecord goes through, up to a broken one
+  bool broken = false;               // a record length marker is wrong, the file ends after nRecords
+  int nrShow = 0;                    // number of showers announced by the RUNH
+  int nEVTE = 0;
+
+  void Clear() { *this = RecordIndex(); };
+
+  /// Entries of the EVTH sub-blocks, element e is shower e + 1
+  std::vector<size_t> EventHeaders() const;
+};
+
+/// <file>.index, next to the DAT file
+std::string indexNameOf(const std::string& datFile);
+
+/// Writes the index of datFile (a temporary file renamed into place), false if it cannot be written
+bool writeRecordIndex(const std::string& datFile, int recordBytes, int subBlockWords, const RecordIndex& index);
+
+/// Reads the index of datFile, false with the reason in error if there is none, it cannot be read
+/// or it does not belong to the current datFile (size, modification time or record length differ)
+bool readRecordIndex(const std::string& datFile, int recordBytes, RecordIndex& index, std::string& error);
+
+#endif
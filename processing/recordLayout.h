@@ -0,0 +1,58 @@
+#ifndef RECORDLAYOUT_H
+#define RECORDLAYOUT_H
+
+#include <cstdint>
+#include <cstring>
+
+/// --------------------------------------------------------------------------------------------
+/// Layout of the records of a CORSIKA particle file
+/// --------------------------------------------------------------------------------------------
+/// A record holds 21 sub-blocks between a leading and a trailing record length word. Thinned
+/// files have 8 words per particle (the 8th is the weight), standard files 7, and 39 particles per
+/// sub-block in both. The parser and the particle kernels are instantiated once per layout, so
+/// the sizes are compile-time constants and standard files carry no weight branch.
+template <bool thinned>
+struct RecordLayout {
+  static constexpr bool weighted = thinned;                    // the particles carry a weight word
+  static constexpr int particleWords = thinned ? 8 : 7;
+  static constexpr int subBlockWords = thinned ? 312 : 273;    // nsblstd
+  static constexpr int subBlocks = 21;
+  static constexpr int particlesPerBlock = subBlockWords / particleWords;
+  static constexpr int recordBytes = (subBlocks * subBlockWords + 2) * 4;   // nrecstd, 26216 or 22940
+
+  static const char* Name() { return thinned ? "thinned" : "standard"; };
+};
+
+typedef RecordLayout<true> ThinnedLayout;
+typedef RecordLayout<false> StandardLayout;
+
+static_assert(ThinnedLayout::recordBytes == 26216 && StandardLayout::recordBytes == 22940,
+              "CORSIKA record lengths");
+static_assert(ThinnedLayout::particlesPerBlock == 39 && StandardLayout::particlesPerBlock == 39,
+              "39 particles per sub-block");
+
+/// --------------------------------------------------------------------------------------------
+/// Sub-block tags
+/// --------------------------------------------------------------------------------------------
+/// Header sub-blocks start with their name in ASCII. The first word read as a 32-bit integer (in
+/// host byte order, little-endian like the floats of the file) is compared against these constants.
+constexpr uint32_t subBlockTag(const char (&name)[5]) {
+  return (uint32_t) name[0] | (uint32_t) name[1] << 8 | (uint32_t) name[2] << 16 | (uint32_t) name[3] << 24;
+}
+
+enum SubBlockTag : uint32_t {
+  RunHeaderTag   = subBlockTag("RUNH"),
+  EventHeaderTag = subBlockTag("EVTH"),
+  LongTag        = subBlockTag("LONG"),
+  EventEndTag    = subBlockTag("EVTE"),
+  RunEndTag      = subBlockTag("RUNE"),
+};
+
+/// The first word of a sub-block as a tag, anything but the constants above is particle data
+inline uint32_t subBlockTag(const float* subBlock) {
+  uint32_t tag;
+  memcpy(&tag, subBlock, sizeof(tag));
+  return tag;
+}
+
+#endif
@@ -0,0 +1,326 @@
+#include "recordSource.h"
+#include "compressedStream.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+MappedRecordSource::MappedRecordSource(const char* mapping, size_t size, size_t recBytes) {
+  base = mapping;
+  fileSize = size;
+  recordBytes = recBytes;
+}
+
+MappedRecordSource::~MappedRecordSource() {
+  munmap((void*) base, fileSize);
+}
+
+const float* MappedRecordSource::Next() {
+  if (offset + recordBytes > fileSize) {
+    return nullptr;
+  }
+  const float* record = (const float*) (base + offset);
+  offset += recordBytes;
+  return record;
+}
+
+StreamRecordSource::StreamRecordSource(const std::string& fileName, size_t recBytes)
+  : is(fileName, std::ifstream::binary), buffer(recBytes / sizeof(float)) {
+}
+
+const float* StreamRecordSource::Next() {
+  if ( !is.read((char*) buffer.data(), buffer.size() * sizeof(float)) ) {
+    partial = is.gcount();
+    return nullptr;
+  }
+  return buffer.data();
+}
+
+AsyncRecordSource::AsyncRecordSource(const std::string& fileName_, int fd_, size_t fileSize_, size_t recBytes,
+                                     size_t readBytes, int queueDepth)
+  : fileName(fileName_), fd(fd_), fileSize(fileSize_), recordBytes(recBytes) {
+  chunkBytes = std::max<size_t>(1, readBytes / recordBytes) * recordBytes;
+  nChunks = (fileSize + chunkBytes - 1) / chunkBytes;
+  slots.resize(std::max<size_t>(1, std::min<size_t>(std::max(queueDepth, 1), nChunks)));
+  for (size_t s = 0; s < slots.size(); ++s) {
+    void* data = nullptr;
+    if (posix_memalign(&data, 4096, chunkBytes) != 0) {
+      // Fewer reads in flight rather than none at all
+      slots.resize(s);
+      break;
+    }
+    slots[s].data = (char*) data;
+  }
+  if (slots.empty()) {
+    error = "cannot allocate read buffers for " + fileName;
+    atEnd = true;
+    return;
+  }
+  for (size_t s = 0; s < slots.size() && s < nChunks; ++s) {
+    readers.push_back(std::thread(&AsyncRecordSource::ReadAhead, this, s));
+  }
+}
+
+AsyncRecordSource::~AsyncRecordSource() {
+  {
+    std::lock_guard<std::mutex> lock(m);
+    stopped = true;
+  }
+  spaceReady.notify_all();
+  for (size_t t = 0; t < readers.size(); ++t) {
+    readers[t].join();
+  }
+  for (size_t s = 0; s < slots.size(); ++s) {
+    free(slots[s].data);
+  }
+  close(fd);
+}
+
+/// I/O thread of slot first, reads chunks first, first + queue depth, ... as the parser frees the slot
+void AsyncRecordSource::ReadAhead(size_t first) {
+  Slot& slot = slots[first];
+  for (size_t c = first; c < nChunks; c += slots.size()) {
+    {
+      std::unique_lock<std::mutex> lock(m);
+      spaceReady.wait(lock, [&] { return stopped || !slot.ready; });
+      if (stopped) {
+        return;
+      }
+    }
+    const off_t offset = (off_t) c * chunkBytes;
+    const size_t want = std::min(chunkBytes, fileSize - c * chunkBytes);
+    size_t got = 0;
+    std::string status;
+    while (got < want) {
+      ssize_t n = pread(fd, slot.data + got, want - got, offset + got);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n < 0) {
+        status = "read error in " + fileName + ": " + strerror(errno);
+        break;
+      }
+      if (n == 0) {
+        break;   // the file got shorter since it was opened
+      }
+      got += n;
+    }
+    {
+      std::lock_guard<std::mutex> lock(m);
+      slot.bytes = status.empty() ? got : 0;
+      slot.ready = true;
+      if (!status.empty() && error.empty()) {
+        error = status;
+      }
+    }
+    dataReady.notify_all();
+    if (got < want) {
+      return;
+    }
+  }
+}
+
+/// Releases the chunk being parsed and waits for the next one, false at the end of the file
+bool AsyncRecordSource::Acquire() {
+  std::unique_lock<std::mutex> lock(m);
+  if (holding) {
+    slots[(chunk - 1) % slots.size()].ready = false;
+    holding = false;
+    spaceReady.notify_all();
+  }
+  if (atEnd || chunk >= nChunks) {
+    return false;
+  }
+  Slot& slot = slots[chunk % slots.size()];
+  dataReady.wait(lock, [&] { return slot.ready; });
+  current = slot.data;
+  currentBytes = slot.bytes;
+  currentPos = 0;
+  atEnd = (slot.bytes < chunkBytes);
+  chunk += 1;
+  holding = true;
+  return true;
+}
+
+const float* AsyncRecordSource::Next() {
+  while (currentPos + recordBytes > currentBytes) {
+    if ( !Acquire() ) {
+      return nullptr;
+    }
+  }
+  const float* record = (const float*) (current + currentPos);
+  currentPos += recordBytes;
+  return record;
+}
+
+std::string AsyncRecordSource::Error() const {
+  std::lock_guard<std::mutex> lock(m);
+  return error;
+}
+
+ResyncRecordSource::ResyncRecordSource(RecordSource& inner_, size_t recBytes, const std::vector<uint32_t>& markers_)
+  : inner(inner_), recordBytes(recBytes), markers(markers_), record(recBytes / sizeof(float)) {
+}
+
+const float* ResyncRecordSource::Next() {
+  if (!shifted) {
+    last = inner.Next();
+    current = next;
+    next += recordBytes;
+    return last;
+  }
+  // The record handed out before is no longer needed
+  window.erase(window.begin(), window.begin() + pos);
+  windowOffset += pos;
+  pos = 0;
+  if (!Fill(recordBytes)) {
+    return nullptr;
+  }
+  memcpy(record.data(), window.data(), recordBytes);
+  current = windowOffset;
+  pos = recordBytes;
+  return record.data();
+}
+
+/// At least bytes in the window, appending records of the wrapped source
+bool ResyncRecordSource::Fill(size_t bytes) {
+  while (window.size() < bytes) {
+    const float* data = inner.Next();
+    if (!data) {
+      // The bytes after the last complete record of the wrapped source, once
+      const char* tail;
+      size_t n = atEnd ? 0 : inner.Trailing(tail);
+      atEnd = true;
+      if (n == 0) {
+        return false;
+      }
+      window.insert(window.end(), tail, tail + n);
+      continue;
+    }
+    window.insert(window.end(), (const char*) data, (const char*) data + recordBytes);
+  }
+  return true;
+}
+
+bool ResyncRecordSource::IsMarker(size_t at) const {
+  uint32_t word;
+  memcpy(&word, window.data() + at, sizeof(word));
+  return std::find(markers.begin(), markers.end(), word) != markers.end();
+}
+
+/// First position in [from, to) where a marker word starts, to if there is none
+size_t ResyncRecordSource::FindMarker(size_t from, size_t to) const {
+  const unsigned char* data = (const unsigned char*) window.data();
+  size_t found = to;
+  for (uint32_t marker : markers) {
+    const unsigned char low = marker & 0xff;
+    for (size_t p = from; p < found; ++p) {
+      const void* hit = memchr(data + p, low, found - p);
+      if (!hit) {
+        break;
+      }
+      p = (const unsigned char*) hit - data;
+      uint32_t word;
+      memcpy(&word, data + p, sizeof(word));
+      if (word == marker) {
+        found = p;
+        break;
+      }
+    }
+  }
+  return found;
+}
+
+bool ResyncRecordSource::SkipTo(uint64_t offset) {
+  while (next + recordBytes <= offset) {
+    if (!inner.Next()) {
+      return false;
+    }
+    next += recordBytes;
+  }
+  if (next == offset) {
+    return true;
+  }
+  // Framed at another offset than the records of the wrapped source
+  shifted = true;
+  windowOffset = next;
+  if (!Fill(offset - next)) {
+    return false;
+  }
+  pos = offset - windowOffset;
+  return true;
+}
+
+bool ResyncRecordSource::Resync(uint64_t& lostBegin, uint64_t& lostEnd) {
+  if (!shifted) {
+    window.assign((const char*) last, (const char*) last + recordBytes);
+    windowOffset = current;
+    shifted = true;
+  }
+  // The window starts with the broken record
+  pos = 0;
+  lostBegin = current;
+  size_t p = 1;
+  for (;;) {
+    if (window.size() < p + recordBytes) {
+      // Keep only the bytes not scanned yet, so a long corrupted stretch does not pile up
+      window.erase(window.begin(), window.begin() + p);
+      windowOffset += p;
+      p = 0;
+      if (!Fill(recordBytes)) {
+        lostEnd = windowOffset + window.size();
+        pos = window.size();
+        return false;
+      }
+    }
+    size_t candidate = FindMarker(p, window.size() - recordBytes + 1);
+    if (candidate + recordBytes > window.size()) {
+      p = window.size() - recordBytes + 1;
+    } else if (IsMarker(candidate + recordBytes - 4)) {
+      pos = candidate;
+      lostEnd = windowOffset + candidate;
+      return true;
+    } else {
+      p = candidate + 1;
+    }
+  }
+}
+
+std::unique_ptr<RecordSource> openRecordSource(const std::string& fileName, int recordBytes, const ReadSettings& settings) {
+  if (detectCompression(fileName) != Compression::None) {
+    return std::unique_ptr<RecordSource>(new CompressedRecordSource(fileName, recordBytes));
+  }
+  if (settings.async) {
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd >= 0) {
+      struct stat st;
+      if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        return std::unique_ptr<RecordSource>(new AsyncRecordSource(fileName, fd, st.st_size, recordBytes,
+                                                                   settings.readBytes, settings.queueDepth));
+      }
+      close(fd);
+    }
+  }
+  if (settings.useMmap) {
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd >= 0) {
+      struct stat st;
+      if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+          close(fd); // the mapping keeps the file alive
+          // Records are consumed strictly front to back, let the kernel read ahead aggressively
+          posix_madvise(mapping, st.st_size, POSIX_MADV_SEQUENTIAL);
+          return std::unique_ptr<RecordSource>(new MappedRecordSource((const char*) mapping, st.st_size, recordBytes));
+        }
+      }
+      close(fd);
+    }
+  }
+  return std::unique_ptr<RecordSource>(new StreamRecordSource(fileName, recordBytes));
+}
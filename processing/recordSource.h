@@ -0,0 +1,182 @@
+#ifndef RECORDSOURCE_H
+#define RECORDSOURCE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+
+/// --------------------------------------------------------------------------------------------
+/// Sources of fixed-length CORSIKA records
+/// --------------------------------------------------------------------------------------------
+/// A record source hands out one full record at a time (nrecstd bytes, including the leading and
+/// trailing record length markers). The returned pointer is only valid until the next call to Next().
+/// Next() returns a null pointer once no complete record is left, a trailing partial record is ignored.
+class RecordSource {
+public:
+  virtual ~RecordSource() {};
+
+  virtual const float* Next() = 0;
+
+  /// Random access to record i, only for sources that hold the whole file (RandomAccess() == true)
+  virtual bool RandomAccess() const { return false; };
+  virtual size_t NumRecords() const { return 0; };
+  virtual const float* Record(size_t) const { return nullptr; };
+
+  /// Why the data ended early (e.g. corrupt compressed data), empty if the source is fine
+  virtual std::string Error() const { return std::string(); };
+
+  /// The bytes after the last complete record once Next() has returned a null pointer, valid until the
+  /// source is destroyed (--resync frames the records at other offsets, they may complete one there)
+  virtual size_t Trailing(const char*& data) { data = nullptr; return 0; };
+};
+
+/// Zero-copy reader, records are handed out straight from a read-only mapping of the whole file
+class MappedRecordSource : public RecordSource {
+  const char* base = nullptr;
+  size_t fileSize = 0;
+  size_t offset = 0;
+  size_t recordBytes = 0;
+public:
+  MappedRecordSource(const char* mapping, size_t size, size_t recBytes);
+  ~MappedRecordSource();
+
+  const float* Next();
+  size_t Trailing(const char*& data) { data = base + offset; return fileSize - offset; };
+
+  bool RandomAccess() const { return true; };
+  size_t NumRecords() const { return fileSize / recordBytes; };
+  const float* Record(size_t i) const { return (const float*) (base + i * recordBytes); };
+};
+
+/// Streaming fallback (pipes, special files or failed mmap), copies each record into a local buffer
+class StreamRecordSource : public RecordSource {
+  std::ifstream is;
+  std::vector<float> buffer;
+  size_t partial = 0;
+public:
+  StreamRecordSource(const std::string& fileName, size_t recBytes);
+
+  const float* Next();
+  size_t Trailing(const char*& data) { data = (const char*) buffer.data(); return partial; };
+};
+
+/// --------------------------------------------------------------------------------------------
+/// Read-ahead for shared filesystems (NFS, Lustre)
+/// --------------------------------------------------------------------------------------------
+/// queueDepth I/O threads keep that many large pread()s of whole records in flight, each into its
+/// own page-aligned buffer, while the parser works through the buffer that arrived before. Reads
+/// are issued in file order and consumed in file order, records are handed out without copying.
+/// (POSIX thread version of an io_uring/aio queue, only needs a file descriptor that supports pread.)
+class AsyncRecordSource : public RecordSource {
+public:
+  AsyncRecordSource(const std::string& fileName, int fd, size_t fileSize, size_t recBytes,
+                    size_t readBytes, int queueDepth);
+  ~AsyncRecordSource();
+
+  const float* Next();
+  std::string Error() const;
+  size_t Trailing(const char*& data) { data = current ? current + currentPos : nullptr; return current ? currentBytes - currentPos : 0; };
+
+private:
+  struct Slot {
+    char* data = nullptr;
+    size_t bytes = 0;     // valid bytes once ready, less than chunkBytes only for the last chunk
+    bool ready = false;   // filled by its I/O thread, not yet released by the parser
+  };
+
+  void ReadAhead(size_t first);
+  bool Acquire();
+
+  std::string fileName;
+  int fd;
+  size_t fileSize;
+  size_t recordBytes;
+  size_t chunkBytes;      // bytes per read, a multiple of recordBytes
+  size_t nChunks;
+  std::vector<Slot> slots;   // chunk c goes to slot c % slots.size()
+  std::vector<std::thread> readers;
+  bool stopped = false;
+  std::string error;
+  mutable std::mutex m;
+  std::condition_variable dataReady;
+  std::condition_variable spaceReady;
+
+  size_t chunk = 0;       // next chunk the parser takes
+  const char* current = nullptr;
+  size_t currentBytes = 0;
+  size_t currentPos = 0;
+  bool holding = false;
+  bool atEnd = false;
+};
+
+/// --------------------------------------------------------------------------------------------
+/// Resynchronization after a corrupted record (--resync)
+/// --------------------------------------------------------------------------------------------
+/// Wraps another source and hands out its records unchanged until Resync() is called on a broken
+/// one. Resync() then scans the bytes after the start of that record for the next position whose
+/// word and the word recordBytes - 4 bytes later are both record length markers (a memchr for the
+/// low byte of each marker, then a compare), and Next() continues with records framed from there.
+/// Once resynchronized, records are copied out of a window over the concatenated records of the
+/// wrapped source, so they can start at any byte offset.
+class ResyncRecordSource : public RecordSource {
+public:
+  /// markers are the accepted record length words as 32-bit integers in host byte order
+  ResyncRecordSource(RecordSource& inner, size_t recBytes, const std::vector<uint32_t>& markers);
+
+  const float* Next();
+  std::string Error() const { return inner.Error(); };
+
+  /// The record last returned by Next() is broken: skips to the next record with valid markers,
+  /// [lostBegin, lostEnd) are the bytes skipped. False if there is none, everything from the broken
+  /// record on is lost then.
+  bool Resync(uint64_t& lostBegin, uint64_t& lostEnd);
+
+  /// Before the first Next(): the next record starts at byte offset (a checkpoint taken after a
+  /// Resync), false if the data ends before
+  bool SkipTo(uint64_t offset);
+
+  /// Byte offset of the record last returned by Next()
+  uint64_t Offset() const { return current; };
+  /// Bytes after the last full record and their offset once Next() has returned nullptr (only known
+  /// when the records are framed at other offsets than those of the wrapped source)
+  size_t Leftover(uint64_t& offset) const { offset = windowOffset + pos; return shifted ? window.size() - pos : 0; };
+
+private:
+  bool Fill(size_t bytes);
+  size_t FindMarker(size_t from, size_t to) const;
+  bool IsMarker(size_t at) const;
+
+  RecordSource& inner;
+  size_t recordBytes;
+  std::vector<uint32_t> markers;
+  const float* last = nullptr;   // record last returned before the first Resync
+  bool shifted = false;
+  bool atEnd = false;            // the trailing bytes of the wrapped source are in the window
+  std::vector<char> window;      // bytes of the concatenated records from windowOffset on
+  uint64_t windowOffset = 0;
+  size_t pos = 0;                // window position of the next record
+  std::vector<float> record;     // aligned copy of the record handed out
+  uint64_t current = 0;
+  uint64_t next = 0;
+};
+
+/// How uncompressed files are read
+struct ReadSettings {
+  bool useMmap = true;
+  bool async = false;            // AsyncRecordSource instead of mmap/streaming
+  size_t readBytes = 4 << 20;    // per read, rounded down to whole records
+  int queueDepth = 4;            // reads in flight
+};
+
+/// Opens fileName with the mmap reader if possible, otherwise (or if useMmap is false) with the streaming one.
+/// With settings.async regular files go through an AsyncRecordSource instead.
+/// Compressed files (gzip, bzip2, zstd magic bytes) are read through a CompressedRecordSource.
+std::unique_ptr<RecordSource> openRecordSource(const std::string& fileName, int recordBytes, const ReadSettings& settings);
+
+#endif
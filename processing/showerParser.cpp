@@ -0,0 +1,427 @@
+#include "showerParser.h"
+#include "particleExport.h"
+#include "batchRunner.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <math.h>
+#include <bitset>
+#include <climits>
+#include <cstring>
+using namespace std;
+
+// Record length markers as float bit patterns: 26208 (thinned) and 22932 (standard) bytes, and 32758
+static const float kThinnedMarker = 3.67252e-41;
+static const float kStandardMarker = 3.21346e-41;
+static const float kOtherMarker = 4.59037e-41;
+
+bool getBinary(float g, bool thinned) {
+  union
+  {
+    float input; // assumes sizeof(float) == sizeof(int)
+    int   output;
+  } data1;
+  union
+  {
+    float input; // assumes sizeof(float) == sizeof(int)
+    int   output;
+  } data1a;
+  union
+  {
+    float input; // assumes sizeof(float) == sizeof(int)
+    int   output;
+  } data2;
+
+  if (thinned) {
+    data1.input = kThinnedMarker; // must be this for thinned files
+  } else {
+    data1.input = kStandardMarker; // must be this for non-thinned (standard) files
+  }
+
+  data1a.input = kOtherMarker;
+  data2.input = g;
+
+  std::bitset<sizeof(float) * CHAR_BIT> bits1(data1.output);
+  std::bitset<sizeof(float) * CHAR_BIT> bits1a(data1a.output);
+  std::bitset<sizeof(float) * CHAR_BIT> bits2(data2.output);
+  if ((bits1 == bits2) || (bits1a == bits2)) {
+    return true;
+  }
+
+  return false;
+}
+
+vector<uint32_t> recordMarkers(bool thinned) {
+  vector<uint32_t> markers;
+  for (float marker : {thinned ? kThinnedMarker : kStandardMarker, kOtherMarker}) {
+    uint32_t word;
+    memcpy(&word, &marker, sizeof(word));
+    markers.push_back(word);
+  }
+  return markers;
+}
+
+ShowerCounters ShowerCounters::Empty() const {
+  ShowerCounters empty(*this);
+  empty.Reset();
+  return empty;
+}
+
+static void readEventHeader(const float* sdata, int j, int nsblstd, EventHeader& event) {
+  ///  Reading primary type and energy
+  event.primaryID = sdata[j * nsblstd + 1 + 2];
+  event.primaryEnergy = sdata[j * nsblstd + 1 + 3];
+  event.zenith = sdata[j * nsblstd + 11];
+  event.azimuth = sdata[j * nsblstd + 12];
+  event.azimuthCorr = event.azimuth - PI;
+  event.numObsLevels = sdata[j * nsblstd + 47]; // Number of observation levels
+  event.obslev = sdata[j * nsblstd + 47 + 1]; // Height of first observation level in cm (will only be 1 obslev if curved surface)
+  event.CurvedObsLevFlag = sdata[j * nsblstd + 168]; // == 1 if observation level is curved, == 0 if flat
+  event.geometry = eventGeometry(event.zenith, event.azimuth, event.CurvedObsLevFlag == 1, event.obslev);
+}
+
+/// Sub-blocks jBegin..jEnd-1 of a record, without the record length markers
+template <class Layout>
+static void processSubBlocks(const float* sdata, int jBegin, int jEnd, ParseState& state, ShowerCounters& counters) {
+  const int nsblstd = Layout::subBlockWords;
+  EventHeader& event = state.event;
+
+  for (int j = jBegin; j < jEnd; j++) {
+    const uint32_t tag = subBlockTag(&sdata[j * nsblstd + 1]);
+    switch (tag) {
+      case RunHeaderTag:
+      case EventHeaderTag:
+      case LongTag:
+      case EventEndTag:
+      case RunEndTag:
+        if (state.index) {
+          state.index->entries.push_back(IndexEntry{tag, state.record, j});
+        }
+        break;
+    }
+    switch (tag) {
+      case RunHeaderTag:
+        state.nrShow = sdata[j * nsblstd + 93];
+        break;
+      case EventHeaderTag:
+        readEventHeader(sdata, j, nsblstd, event);
+        state.headers.push_back(event);
+        if (state.perEvent) {
+          counters.Reset();
+        }
+        break;
+      case EventEndTag:
+        state.EVTEcnt += 1;
+        if (state.perEvent && !state.headers.empty()) {
+          state.events.push_back(EventCounters());
+          state.events.back().header = state.headers.size() - 1;
+          state.events.back().counters = counters;
+        }
+        break;
+      case LongTag:
+      case RunEndTag:
+        break;
+      default: { /// READ DATA -> classify all particles of the sub-block at once
+        const int nParticles = Layout::particlesPerBlock;
+        BlockLanes lanes;
+        classifyBlock<Layout>(&sdata[j * nsblstd + 1], event.geometry, lanes);
+        if (state.exporter) {
+          state.exporter->AddBlock(&sdata[j * nsblstd + 1], nParticles, Layout::particleWords, lanes, state.headers.size());
+        }
+
+        counters.FillBlock(lanes, nParticles);
+      }
+    }
+  }
+}
+
+static const char* kBrokenBegin = "This file is corrupted, this is not a record length - beginning of block!";
+static const char* kBrokenEnd = "This file is corrupted, this is not a record length - end of block!";
+
+template <class Layout>
+bool processRecord(const float* sdata, ParseState& state, ShowerCounters& counters) {
+  if ( !getBinary( sdata[0], Layout::weighted ) ) { /// skip the first  record length sdata[0]
+    cerr << kBrokenBegin << endl;
+    if (state.index) {
+      state.index->broken = true;
+    }
+    return false;
+  }
+  /// iterate over 21 sub block inside this block
+  processSubBlocks<Layout>(sdata, 0, Layout::subBlocks, state, counters);
+  state.record += 1;
+  if (state.index) {
+    state.index->nRecords = state.record;
+  }
+  /// end of the record
+  if ( !getBinary( sdata[Layout::subBlocks * Layout::subBlockWords + 1], Layout::weighted ) ) {
+    cerr << kBrokenEnd << endl;
+    if (state.index) {
+      state.index->broken = true;
+    }
+    return false;
+  }
+  return true;
+}
+
+/// --------------------------------------------------------------------------------------------
+/// Record-range parallel processing
+/// --------------------------------------------------------------------------------------------
+/// Particle sub-blocks only depend on the EVTH before them. Each worker first looks up the last
+/// EVTH in its own range, so that afterwards every worker knows the geometry its range starts with.
+
+struct RangeWorker {
+  size_t first = 0;
+  size_t last = 0;                    // one past the last record of the range
+  const float* lastEVTH = nullptr;    // record holding the last EVTH of the range
+  int lastEVTHBlock = 0;
+  ParseState state;
+  ShowerCounters counters;
+  RecordIndex index;
+  bool broken = false;
+};
+
+template <class Layout>
+static void findLastEVTH(const RecordSource& source, RangeWorker& worker) {
+  for (size_t r = worker.first; r < worker.last; ++r) {
+    const float* sdata = source.Record(r);
+    for (int j = 0; j < Layout::subBlocks; j++) {
+      if (subBlockTag(&sdata[j * Layout::subBlockWords + 1]) == EventHeaderTag) {
+        worker.lastEVTH = sdata;
+        worker.lastEVTHBlock = j;
+      }
+    }
+  }
+}
+
+template <class Layout>
+static void processRange(const RecordSource& source, RangeWorker& worker) {
+  for (size_t r = worker.first; r < worker.last; ++r) {
+    if ( !processRecord<Layout>(source.Record(r), worker.state, worker.counters) ) {
+      worker.broken = true;
+      break;
+    }
+  }
+}
+
+template <class Layout>
+bool processRecordsParallel(const RecordSource& source, int nThreads, ParseState& state, ShowerCounters& counters) {
+  const size_t nRecords = source.NumRecords();
+  if (nRecords == 0) {
+    return true;
+  }
+  if ((size_t) nThreads > nRecords) {
+    nThreads = nRecords;
+  }
+
+  vector<RangeWorker> workers(nThreads);
+  for (int t = 0; t < nThreads; ++t) {
+    workers[t].first = nRecords * t / nThreads;
+    workers[t].last = nRecords * (t + 1) / nThreads;
+  }
+
+  vector<thread> pool;
+  for (int t = 0; t < nThreads; ++t) {
+    pool.push_back(thread(findLastEVTH<Layout>, std::cref(source), std::ref(workers[t])));
+  }
+  for (size_t t = 0; t < pool.size(); ++t) {
+    pool[t].join();
+  }
+  pool.clear();
+
+  /// Every range starts with the geometry of the last EVTH before it, -1 marks "no RUNH in this range"
+  EventHeader current = state.event;
+  for (int t = 0; t < nThreads; ++t) {
+    workers[t].counters = counters.Empty();
+    workers[t].state.nrShow = -1;
+    workers[t].state.event = current;
+    workers[t].state.record = workers[t].first;
+    if (state.index) {
+      workers[t].state.index = &workers[t].index;
+    }
+    if (workers[t].lastEVTH) {
+      readEventHeader(workers[t].lastEVTH, workers[t].lastEVTHBlock, Layout::subBlockWords, current);
+    }
+  }
+
+  for (int t = 0; t < nThreads; ++t) {
+    pool.push_back(thread(processRange<Layout>, std::cref(source), std::ref(workers[t])));
+  }
+  for (size_t t = 0; t < pool.size(); ++t) {
+    pool[t].join();
+  }
+
+  /// Merge in record order, nothing after the first broken record counts (as when reading sequentially)
+  for (int t = 0; t < nThreads; ++t) {
+    const RangeWorker& worker = workers[t];
+    counters.Merge(worker.counters);
+    if (worker.state.nrShow != -1) {
+      state.nrShow = worker.state.nrShow;
+    }
+    state.EVTEcnt += worker.state.EVTEcnt;
+    state.headers.insert(state.headers.end(), worker.state.headers.begin(), worker.state.headers.end());
+    state.event = worker.state.event;
+    state.record = worker.state.record;
+    if (state.index) {
+      state.index->entries.insert(state.index->entries.end(), worker.index.entries.begin(), worker.index.entries.end());
+      state.index->nRecords = worker.index.nRecords;
+      state.index->broken = worker.index.broken;
+    }
+    if (worker.broken) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// --------------------------------------------------------------------------------------------
+/// Event parallel processing
+/// --------------------------------------------------------------------------------------------
+/// A shower runs from its EVTH up to the next EVTH. Particles outside of the showers (before the
+/// first EVTH or between an EVTE and the next EVTH) are dropped in per-event mode anyway. The
+/// boundaries come from a RecordIndex, of the .index file or from a pass over the headers first.
+
+template <class Layout>
+void indexRecords(const RecordSource& source, RecordIndex& index) {
+  const size_t nRecords = source.NumRecords();
+  const int nsblstd = Layout::subBlockWords;
+
+  index.Clear();
+  for (size_t r = 0; r < nRecords; ++r) {
+    const float* sdata = source.Record(r);
+    if ( !getBinary( sdata[0], Layout::weighted ) ) {
+      cerr << kBrokenBegin << endl;
+      index.broken = true;
+      return;
+    }
+    for (int j = 0; j < Layout::subBlocks; j++) {
+      const uint32_t tag = subBlockTag(&sdata[j * nsblstd + 1]);
+      switch (tag) {
+        case RunHeaderTag:
+          index.nrShow = sdata[j * nsblstd + 93];
+          index.entries.push_back(IndexEntry{tag, r, j});
+          break;
+        case EventEndTag:
+          index.nEVTE += 1;
+          index.entries.push_back(IndexEntry{tag, r, j});
+          break;
+        case EventHeaderTag:
+        case LongTag:
+        case RunEndTag:
+          index.entries.push_back(IndexEntry{tag, r, j});
+          break;
+      }
+    }
+    index.nRecords = r + 1;
+    if ( !getBinary( sdata[Layout::subBlocks * nsblstd + 1], Layout::weighted ) ) {
+      cerr << kBrokenEnd << endl;
+      index.broken = true;
+      return;
+    }
+  }
+}
+
+template <class Layout>
+bool processEventsParallel(const RecordSource& source, const RecordIndex& index, int nThreads, size_t onlyEvent,
+                           ParseState& state, const ShowerCounters& counters) {
+  /// The EVTH of every shower, read at its position
+  vector<size_t> starts = index.EventHeaders();
+  for (size_t e = 0; e < starts.size(); ++e) {
+    const IndexEntry& evth = index.entries[starts[e]];
+    readEventHeader(source.Record(evth.record), evth.block, Layout::subBlockWords, state.event);
+    state.headers.push_back(state.event);
+  }
+  state.nrShow = index.nrShow;
+  state.EVTEcnt = index.nEVTE;
+
+  /// Every shower on its own, with its own state and counters, it ends at the next EVTH or the end of the file
+  const size_t nEvents = starts.size();
+  const size_t first = (onlyEvent > 0) ? min(onlyEvent - 1, nEvents) : 0;
+  const size_t last = (onlyEvent > 0) ? min(onlyEvent, nEvents) : nEvents;
+  vector<ParseState> eventStates(last - first);
+  vector<ShowerCounters> eventCounters(last - first, counters.Empty());
+  vector<size_t> cost(last - first);
+  for (size_t e = first; e < last; ++e) {
+    size_t end = (e + 1 < nEvents) ? index.entries[starts[e + 1]].record + 1 : index.nRecords;
+    cost[e - first] = end - index.entries[starts[e]].record;
+    eventStates[e - first].perEvent = true;
+  }
+
+  runBatch(cost, nThreads,
+    [&](size_t k) {
+      const size_t e = first + k;
+      const IndexEntry& begin = index.entries[starts[e]];
+      const IndexEntry end = (e + 1 < nEvents) ? index.entries[starts[e + 1]] : IndexEntry{0, index.nRecords, 0};
+      for (size_t r = begin.record; r < index.nRecords && r <= end.record; ++r) {
+        int jBegin = (r == begin.record) ? begin.block : 0;
+        int jEnd = (r == end.record) ? end.block : Layout::subBlocks;
+        processSubBlocks<Layout>(source.Record(r), jBegin, jEnd, eventStates[k], eventCounters[k]);
+      }
+    },
+    [&](size_t) { return true; });
+
+  for (size_t k = 0; k < eventStates.size(); ++k) {
+    for (EventCounters& closed : eventStates[k].events) {
+      closed.header = first + k;
+      state.events.push_back(std::move(closed));
+    }
+  }
+  return !index.broken;
+}
+
+/// --------------------------------------------------------------------------------------------
+/// Integrity check (--verify)
+/// --------------------------------------------------------------------------------------------
+/// Touches the two markers and the 21 sub-block tags of a record, so it runs as fast as the pages
+/// come in.
+template <class Layout>
+void verifyRecords(RecordSource& source, VerifyReport& report) {
+  const int nsblstd = Layout::subBlockWords;
+
+  report = VerifyReport();
+  while (const float* sdata = source.Next()) {
+    if ( !recordIntact<Layout>(sdata) ) {
+      report.broken = true;
+      return;
+    }
+    for (int j = 0; j < Layout::subBlocks; j++) {
+      switch (subBlockTag(&sdata[j * nsblstd + 1])) {
+        case RunHeaderTag:
+          report.nRUNH += 1;
+          report.nrShow = sdata[j * nsblstd + 93];
+          break;
+        case EventHeaderTag:
+          report.nEVTH += 1;
+          break;
+        case LongTag:
+          report.nLONG += 1;
+          break;
+        case EventEndTag:
+          report.nEVTE += 1;
+          break;
+        case RunEndTag:
+          report.nRUNE += 1;
+          break;
+      }
+    }
+    report.records += 1;
+  }
+  const char* tail;
+  report.trailingBytes = source.Trailing(tail);
+}
+
+template bool processRecord<ThinnedLayout>(const float*, ParseState&, ShowerCounters&);
+template bool processRecord<StandardLayout>(const float*, ParseState&, ShowerCounters&);
+template bool processRecordsParallel<ThinnedLayout>(const RecordSource&, int, ParseState&, ShowerCounters&);
+template bool processRecordsParallel<StandardLayout>(const RecordSource&, int, ParseState&, ShowerCounters&);
+template void indexRecords<ThinnedLayout>(const RecordSource&, RecordIndex&);
+template void indexRecords<StandardLayout>(const RecordSource&, RecordIndex&);
+template void verifyRecords<ThinnedLayout>(RecordSource&, VerifyReport&);
+template void verifyRecords<StandardLayout>(RecordSource&, VerifyReport&);
+template bool processEventsParallel<ThinnedLayout>(const RecordSource&, const RecordIndex&, int, size_t,
+                                                   ParseState&, const ShowerCounters&);
+template bool processEventsParallel<StandardLayout>(const RecordSource&, const RecordIndex&, int, size_t,
+                                                    ParseState&, const ShowerCounters&);
@@ -0,0 +1,131 @@
+#ifndef SHOWERPARSER_H
+#define SHOWERPARSER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "recordSource.h"
+#include "particleKernel.h"
+#include "radialBins.h"
+#include "observables.h"
+#include "recordIndex.h"
+#include "recordLayout.h"
+
+#define PI 3.14159265
+
+bool getBinary(float g, bool thinned);
+
+/// The words getBinary accepts as record length marker, as 32-bit integers (the --resync scan)
+std::vector<uint32_t> recordMarkers(bool thinned);
+
+class ParticleExporter;
+
+/// --------------------------------------------------------------------------------------------
+/// Event headers
+/// --------------------------------------------------------------------------------------------
+/// Values read from an EVTH sub-block, the particle sub-blocks after it use its geometry
+struct EventHeader {
+  float primaryID = 0.;
+  float primaryEnergy = 0.;
+  double zenith = 0.;
+  double azimuth = 0.;
+  double azimuthCorr = 0.;
+  int numObsLevels = 0;
+  double obslev = 0.;
+  int CurvedObsLevFlag = 0;
+  EventGeometry geometry;            // shower axis and distance constants for the particle kernel
+};
+
+/// --------------------------------------------------------------------------------------------
+/// Particle counters, summed over all particle sub-blocks
+/// --------------------------------------------------------------------------------------------
+/// The observables of the output row in column order, plus the optional spectra (observables.h).
+/// Their members are members of the counters, e.g. counters.nMuons or counters.muDist.
+typedef ObservableSet<MuonCounts, MuonThinning, MuonRadial, EMCounts, EMRadial, SpeciesSpectra> ShowerObservables;
+
+struct ShowerCounters : ShowerObservables {
+  ShowerCounters() {};
+  ShowerCounters(const RadialBins& binning) { Setup(binning); };
+
+  /// Zeroed counters with the same radial binning
+  ShowerCounters Empty() const;
+};
+
+/// Counters of one shower (--per-event), header is its EVTH in ParseState::headers
+struct EventCounters {
+  size_t header = 0;
+  ShowerCounters counters;
+};
+
+/// --------------------------------------------------------------------------------------------
+/// State shared between the records of a file
+/// --------------------------------------------------------------------------------------------
+struct ParseState {
+  int nrShow = 0;
+  int EVTEcnt = 0;
+  EventHeader event;                 // the EVTH the following particle sub-blocks belong to
+  std::vector<EventHeader> headers;  // every EVTH read so far, in file order
+  ParticleExporter* exporter = nullptr;   // --export, gets every particle sub-block (sequential reading only)
+  bool perEvent = false;             // --per-event: counters are reset at every EVTH and kept at its EVTE
+  std::vector<EventCounters> events; // with perEvent, every shower closed by an EVTE, in file order
+  size_t record = 0;                 // number of the record processRecord works on
+  RecordIndex* index = nullptr;      // collects the header sub-blocks if set (--write-index)
+  bool lostBytes = false;            // --resync skipped over broken records, the file counts as broken
+};
+
+/// --------------------------------------------------------------------------------------------
+/// Record processing
+/// --------------------------------------------------------------------------------------------
+/// Processes the 21 sub-blocks of one record of the given layout (ThinnedLayout or StandardLayout,
+/// recordLayout.h). Returns false (and reports it) if one of the record length markers is wrong,
+/// in which case the file has to be considered broken.
+/// A broken trailing marker is only detected after the record has been counted, as before.
+template <class Layout>
+bool processRecord(const float* sdata, ParseState& state, ShowerCounters& counters);
+
+/// Both record length markers of a record are right, checked before a record is parsed with --resync
+template <class Layout>
+inline bool recordIntact(const float* sdata) {
+  return getBinary(sdata[0], Layout::weighted) && getBinary(sdata[Layout::subBlocks * Layout::subBlockWords + 1], Layout::weighted);
+}
+
+/// Processes all records of a random access source on nThreads worker threads, each working on a
+/// contiguous record range with its own counters. Gives the same counts as calling processRecord
+/// on every record in order (up to the float summation order). Returns false if the file is broken.
+template <class Layout>
+bool processRecordsParallel(const RecordSource& source, int nThreads, ParseState& state, ShowerCounters& counters);
+
+/// Index of a random access source from its header sub-blocks and record length markers only, as
+/// processRecord on every record in order would find them (reports a broken marker the same way)
+template <class Layout>
+void indexRecords(const RecordSource& source, RecordIndex& index);
+
+/// Integrity of a file without its particles (--verify): the record length markers of every record
+/// and the header sub-blocks, up to the first broken record
+struct VerifyReport {
+  size_t records = 0;        // intact records before the first broken one
+  bool broken = false;       // a record length marker is wrong, at byte records * recordBytes
+  size_t trailingBytes = 0;  // after the last complete record (not known for a broken file)
+  int nRUNH = 0;
+  int nEVTH = 0;
+  int nLONG = 0;
+  int nEVTE = 0;
+  int nRUNE = 0;
+  int nrShow = 0;            // number of showers announced by the RUNH
+};
+
+/// Reads the records of any source in order, only the markers and the first word of every sub-block
+template <class Layout>
+void verifyRecords(RecordSource& source, VerifyReport& report);
+
+/// Per-event counterpart of processRecordsParallel (state.perEvent): with the shower boundaries of
+/// the index (from indexRecords or the .index file) the showers are processed on nThreads worker
+/// threads, only shower onlyEvent (counted from 1) if it is not 0. The EVTH headers are read at
+/// their index positions. Fills state as processRecord on every record in order would, up to the
+/// first broken record. counters only provides the binning. Returns false if the file is broken.
+template <class Layout>
+bool processEventsParallel(const RecordSource& source, const RecordIndex& index, int nThreads, size_t onlyEvent,
+                           ParseState& state, const ShowerCounters& counters);
+
+#endif
@@ -0,0 +1,186 @@
+#include "tarArchive.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+using namespace std;
+
+static const size_t kBlock = 512;
+
+/// Numeric header field, octal text or (GNU) base-256 if the high bit of the first byte is set
+static size_t headerNumber(const char* field, size_t length) {
+  const unsigned char* f = (const unsigned char*) field;
+  size_t value = 0;
+  if (f[0] & 0x80) {
+    for (size_t i = 1; i < length; ++i) {
+      value = (value << 8) | f[i];
+    }
+    return value;
+  }
+  for (size_t i = 0; i < length && f[i] != 0 && f[i] != ' '; ++i) {
+    value = value * 8 + (f[i] - '0');
+  }
+  return value;
+}
+
+/// Text field that is not necessarily zero terminated
+static string headerText(const char* field, size_t length) {
+  return string(field, strnlen(field, length));
+}
+
+/// The checksum treats its own field as spaces
+static bool checksumOK(const char* block) {
+  const unsigned char* b = (const unsigned char*) block;
+  size_t sum = 0;
+  for (size_t i = 0; i < kBlock; ++i) {
+    sum += (i >= 148 && i < 156) ? ' ' : b[i];
+  }
+  return sum == headerNumber(block + 148, 8);
+}
+
+TarReader::TarReader(CompressedStream& in_) : in(in_) {
+}
+
+bool TarReader::ReadBlock(char* block) {
+  if (in.Read(block, kBlock) != kBlock) {
+    broken = true;
+    return false;
+  }
+  return true;
+}
+
+bool TarReader::Skip(size_t n) {
+  char scratch[4096];
+  while (n > 0) {
+    size_t take = min(n, sizeof(scratch));
+    if (in.Read(scratch, take) != take) {
+      broken = true;
+      return false;
+    }
+    n -= take;
+  }
+  return true;
+}
+
+bool TarReader::ReadText(size_t n, string& text) {
+  text.resize(n);
+  if (in.Read(&text[0], n) != n) {
+    broken = true;
+    return false;
+  }
+  return Skip((kBlock - n % kBlock) % kBlock);
+}
+
+bool TarReader::NextMember(string& name, size_t& size) {
+  if ( !Skip(remaining + padding) ) {
+    return false;
+  }
+  remaining = 0;
+  padding = 0;
+
+  string longName;
+  char block[kBlock];
+  for (;;) {
+    if ( !ReadBlock(block) ) {
+      return false;
+    }
+    // A zero block ends the archive
+    bool zero = true;
+    for (size_t i = 0; i < kBlock && zero; ++i) {
+      zero = (block[i] == 0);
+    }
+    if (zero) {
+      return false;
+    }
+    if ( !checksumOK(block) ) {
+      broken = true;
+      return false;
+    }
+
+    const size_t memberSize = headerNumber(block + 124, 12);
+    const char type = block[156];
+
+    if (type == 'L') {
+      // GNU long name of the next member
+      if ( !ReadText(memberSize, longName) ) {
+        return false;
+      }
+      longName = longName.c_str();
+      continue;
+    }
+    if (type == 'x') {
+      // pax records "<length> key=value\n", only the path matters here
+      string records;
+      if ( !ReadText(memberSize, records) ) {
+        return false;
+      }
+      for (size_t pos = 0; pos < records.size(); ) {
+        size_t length = atol(records.c_str() + pos);
+        size_t space = records.find(' ', pos);
+        if (length == 0 || space == string::npos || pos + length > records.size()) {
+          break;
+        }
+        string record = records.substr(space + 1, pos + length - space - 2);
+        if (record.compare(0, 5, "path=") == 0) {
+          longName = record.substr(5);
+        }
+        pos += length;
+      }
+      continue;
+    }
+    if (type != '0' && type != '\0' && type != '7') {
+      // directories, links, global pax headers ...
+      if ( !Skip((memberSize + kBlock - 1) / kBlock * kBlock) ) {
+        return false;
+      }
+      longName.clear();
+      continue;
+    }
+
+    if (longName.empty()) {
+      name = headerText(block, 100);
+      string prefix = (memcmp(block + 257, "ustar", 5) == 0) ? headerText(block + 345, 155) : "";
+      if (!prefix.empty()) {
+        name = prefix + "/" + name;
+      }
+    } else {
+      name = longName;
+    }
+    size = memberSize;
+    remaining = memberSize;
+    padding = (kBlock - memberSize % kBlock) % kBlock;
+    return true;
+  }
+}
+
+size_t TarReader::Read(char* dst, size_t n) {
+  size_t take = min(n, remaining);
+  size_t got = in.Read(dst, take);
+  remaining -= got;
+  if (got < take) {
+    broken = true;
+    remaining = 0;
+    padding = 0;
+  }
+  return got;
+}
+
+const float* TarRecordSource::Next() {
+  const size_t bytes = buffer.size() * sizeof(float);
+  partial = tar.Read((char*) buffer.data(), bytes);
+  if (partial != bytes) {
+    return nullptr;
+  }
+  return buffer.data();
+}
+
+bool isTarArchiveName(const string& fileName) {
+  const char* suffixes[] = {".tar", ".tar.gz", ".tgz", ".tar.bz2", ".tbz2", ".tar.zst", ".tzst"};
+  for (const char* suffix : suffixes) {
+    size_t n = strlen(suffix);
+    if (fileName.size() > n && fileName.compare(fileName.size() - n, n, suffix) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,56 @@
+#ifndef TARARCHIVE_H
+#define TARARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "compressedStream.h"
+#include "recordSource.h"
+
+/// --------------------------------------------------------------------------------------------
+/// Members of a .tar.gz archive, read front to back without extracting them
+/// --------------------------------------------------------------------------------------------
+/// The archive may also be bzip2 or zstd compressed or a plain tar file, see CompressedStream.
+/// Understands ustar/GNU headers (base-256 sizes, GNU long names) and pax path records, which
+/// covers what GNU tar writes. Only regular files are returned, everything else is skipped.
+class TarReader {
+public:
+  explicit TarReader(CompressedStream& in);
+
+  /// Moves to the next regular file, false at the end of the archive or on a broken header
+  bool NextMember(std::string& name, size_t& size);
+
+  /// Data of the current member, less than n only at its end (or if the archive is truncated)
+  size_t Read(char* dst, size_t n);
+
+  /// True if the archive ended inside a header or member, or a header checksum was wrong
+  bool Broken() const { return broken; };
+
+private:
+  bool ReadBlock(char* block);
+  bool Skip(size_t n);
+  bool ReadText(size_t n, std::string& text);
+
+  CompressedStream& in;
+  size_t remaining = 0;   // data bytes of the current member not read yet
+  size_t padding = 0;     // zero bytes up to the next 512 byte block
+  bool broken = false;
+};
+
+/// Records of the current member of a tar archive, copied into a local buffer like StreamRecordSource
+class TarRecordSource : public RecordSource {
+  TarReader& tar;
+  std::vector<float> buffer;
+  size_t partial = 0;
+public:
+  TarRecordSource(TarReader& tar_, size_t recBytes) : tar(tar_), buffer(recBytes / sizeof(float)) {};
+
+  const float* Next();
+  size_t Trailing(const char*& data) { data = (const char*) buffer.data(); return partial; };
+};
+
+/// True for the names of tar archives (.tar, .tar.gz, .tgz, .tar.bz2, .tbz2, .tar.zst, .tzst)
+bool isTarArchiveName(const std::string& fileName);
+
+#endif
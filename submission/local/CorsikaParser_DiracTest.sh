@@ -66,10 +66,8 @@ do
     # Load any needed environment variables here...
 
     EXE=$PARSERLOC/scripts/corsikaReader
-    EXE2=$PARSERLOC/scripts/ParseAndFitLongitudinalProfile_Auger.py
 
-    echo Corsika Block Parser: $EXE
-    echo Corsika Longitudinal Parser: $EXE2
+    echo Corsika Block and Longitudinal Parser: $EXE
 
     for ((iFILE=$IDFirst; iFILE<=$IDLast; iFILE++))
     do
@@ -78,21 +76,15 @@ do
 
       echo Copying from Dirac: $SIMSLOC/${FILENAME}.tar.gz
       dget $SIMSLOC/${FILENAME}.tar.gz $NEWLOC/${FILENAME}.tar.gz >> $NEWLOC/dget_${FILENAME}.log 2>&1
-      tar -xzvf $NEWLOC/${FILENAME}.tar.gz
-      rm $NEWLOC/${FILENAME}.tar.gz
 
       # For debugging and tracking downloaded files
-      echo $NEWLOC/$FILENAME > $NEWLOC/FileNames
-
-      echo Reading: $FILENAME
-      MUON_DATA=$($EXE $FILENAME --thinned)
-      ZENITH=$(echo $MUON_DATA | awk '{print $3}')
-      XMAX_DATA=$($EXE2 ${FILENAME}.long --zen $ZENITH --removeFinal20gcm2)
+      echo $NEWLOC/${FILENAME}.tar.gz > $NEWLOC/FileNames
 
-      echo $MUON_DATA $XMAX_DATA > $OUTLOC/${FILENAME}.txt
+      echo Reading: ${FILENAME}.tar.gz
+      # Particle block and longitudinal profile (${FILENAME}.long) in one row, read straight out of the archive
+      $EXE $NEWLOC/${FILENAME}.tar.gz --thinned --long --remove-final-20gcm2 > $OUTLOC/${FILENAME}.txt
 
-      rm $NEWLOC/$FILENAME
-      rm $NEWLOC/${FILENAME}.long
+      rm $NEWLOC/${FILENAME}.tar.gz
     done
   done  # End loop over primaries
 done  # End loop over atmospheric models
@@ -40,32 +40,23 @@ process_shower() {
     local NEWLOC=$2
     local OUTLOC=$3
     local EXE=$4
-    local EXE2=$5
-
-    echo "Untarring file: tar -xzvf $NEWLOC/${FILENAME}.tar.gz"
-    if tar -xzvf $NEWLOC/${FILENAME}.tar.gz -C $NEWLOC; then
-        echo "Removing unneeded tarball: rm $NEWLOC/${FILENAME}.tar.gz"
-        rm $NEWLOC/${FILENAME}.tar.gz
 
+    if [[ -f $NEWLOC/${FILENAME}.tar.gz ]]; then
         # Append filenames for debugging
-        echo $NEWLOC/$FILENAME >> $NEWLOC/FileNames.log
+        echo $NEWLOC/${FILENAME}.tar.gz >> $NEWLOC/FileNames.log
 
-        echo "Reading: $FILENAME"
-        MUON_DATA=$($EXE $FILENAME --thinned)
-        echo "Executing Corsika Block Parser: $MUON_DATA"
-        
-        ZENITH=$(echo $MUON_DATA | awk '{print $3}')
-        XMAX_DATA=$($EXE2 ${FILENAME}.long --zen $ZENITH --removeFinal20gcm2)
-        echo "Executing Corsika Longitudinal Parser: $XMAX_DATA"
+        echo "Reading: ${FILENAME}.tar.gz"
+        # Particle block and longitudinal profile (${FILENAME}.long) in one row, read straight out of the archive
+        ROW_DATA=$($EXE $NEWLOC/${FILENAME}.tar.gz --thinned --long --remove-final-20gcm2)
+        echo "Executing Corsika Block and Longitudinal Parser: $ROW_DATA"
 
         # Write output
-        echo $MUON_DATA $XMAX_DATA > $OUTLOC/${FILENAME}.txt
+        echo $ROW_DATA > $OUTLOC/${FILENAME}.txt
 
-        echo "Removing untarred files..."
-        rm $NEWLOC/$FILENAME
-        rm $NEWLOC/${FILENAME}.long
+        echo "Removing tarball: rm $NEWLOC/${FILENAME}.tar.gz"
+        rm $NEWLOC/${FILENAME}.tar.gz
     else
-        echo "ERROR: Failed to untar $FILENAME"
+        echo "ERROR: Missing $NEWLOC/${FILENAME}.tar.gz"
     fi
 }
 
@@ -100,10 +91,8 @@ do
     # Load any needed environment variables here...
 
     EXE=$PARSERLOC/corsikaReader
-    EXE2=$PARSERLOC/ParseAndFitLongitudinalProfile_Auger.py
 
-    echo Corsika Block Parser: $EXE
-    echo Corsika Longitudinal Parser: $EXE2
+    echo Corsika Block and Longitudinal Parser: $EXE
 
     for ((iFILE=$IDFirst; iFILE<=$IDLast; iFILE++))
     do
@@ -116,7 +105,7 @@ do
       # Check if download was successful before processing
       if [ -f "$NEWLOC/${FILENAME}.tar.gz" ]; then
           # Run untarring and processing of file in the background (with &)
-          process_shower "$FILENAME" "$NEWLOC" "$OUTLOC" "$EXE" "$EXE2" & 
+          process_shower "$FILENAME" "$NEWLOC" "$OUTLOC" "$EXE" & 
       else
           echo "Download failed for $FILENAME"
       fi